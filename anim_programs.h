@@ -0,0 +1,77 @@
+// Animation programs, generated by tvanimc.py from
+// anim/wave.anim anim/switch.anim anim/race.anim anim/sides.anim
+// do not edit
+
+#ifndef ANIM_PROGRAMS_H_
+#define ANIM_PROGRAMS_H_
+
+#define _N_ANIM 4
+#define _ANIM_NAMES "wave", "switch", "race", "sides"
+
+#endif /* ANIM_PROGRAMS_H_ */
+
+// the programs are only defined in tvanim.c
+#if defined(ANIM_PROGRAMS) && !defined(ANIM_PROGRAMS_DEFINED)
+#define ANIM_PROGRAMS_DEFINED
+
+// wave, 27 bytes
+const uint8_t anim_prog_wave[] PROGMEM = {
+    0x10, 0x01, 0x40, 0x00, 0x64, 0x01, 0x03, 0x00, 0x05, 0x04, 0x06, 0x01,
+    0x01, 0x03, 0x01, 0x05, 0x04, 0x06, 0x01, 0x01, 0x03, 0x02, 0x05, 0x04,
+    0x06, 0x01, 0x00,
+};
+
+// switch, 342 bytes
+const uint8_t anim_prog_switch[] PROGMEM = {
+    0x40, 0x01, 0x40, 0x00, 0x14, 0x02, 0x00, 0x00, 0x00, 0xaa, 0x01, 0x02,
+    0x00, 0xaa, 0x00, 0xfd, 0x02, 0x02, 0x00, 0xfd, 0x01, 0x71, 0x03, 0x02,
+    0x01, 0x71, 0x02, 0x1c, 0x04, 0x05, 0x04, 0x06, 0x01, 0x02, 0x00, 0xaa,
+    0x00, 0xfd, 0x01, 0x02, 0x00, 0xfd, 0x01, 0x71, 0x02, 0x02, 0x01, 0x71,
+    0x02, 0x1c, 0x03, 0x02, 0x00, 0x00, 0x00, 0xaa, 0x04, 0x05, 0x04, 0x06,
+    0x01, 0x02, 0x00, 0xfd, 0x01, 0x71, 0x01, 0x02, 0x01, 0x71, 0x02, 0x1c,
+    0x02, 0x02, 0x00, 0x00, 0x00, 0xaa, 0x03, 0x02, 0x00, 0xaa, 0x00, 0xfd,
+    0x04, 0x05, 0x04, 0x06, 0x01, 0x02, 0x01, 0x71, 0x02, 0x1c, 0x01, 0x02,
+    0x00, 0x00, 0x00, 0xaa, 0x02, 0x02, 0x00, 0xaa, 0x00, 0xfd, 0x03, 0x02,
+    0x00, 0xfd, 0x01, 0x71, 0x04, 0x05, 0x04, 0x06, 0x01, 0x02, 0x00, 0x00,
+    0x00, 0xaa, 0x01, 0x02, 0x00, 0xfd, 0x01, 0x71, 0x02, 0x02, 0x00, 0xaa,
+    0x00, 0xfd, 0x03, 0x02, 0x01, 0x71, 0x02, 0x1c, 0x04, 0x05, 0x04, 0x06,
+    0x01, 0x02, 0x00, 0xaa, 0x00, 0xfd, 0x01, 0x02, 0x00, 0x00, 0x00, 0xaa,
+    0x02, 0x02, 0x01, 0x71, 0x02, 0x1c, 0x03, 0x02, 0x00, 0xfd, 0x01, 0x71,
+    0x04, 0x05, 0x04, 0x06, 0x01, 0x02, 0x00, 0xfd, 0x01, 0x71, 0x01, 0x02,
+    0x00, 0x00, 0x00, 0xaa, 0x02, 0x02, 0x00, 0xaa, 0x00, 0xfd, 0x03, 0x02,
+    0x01, 0x71, 0x02, 0x1c, 0x04, 0x05, 0x04, 0x06, 0x01, 0x02, 0x01, 0x71,
+    0x02, 0x1c, 0x01, 0x02, 0x00, 0xaa, 0x00, 0xfd, 0x02, 0x02, 0x00, 0x00,
+    0x00, 0xaa, 0x03, 0x02, 0x00, 0xfd, 0x01, 0x71, 0x04, 0x05, 0x04, 0x06,
+    0x01, 0x02, 0x00, 0x00, 0x00, 0xaa, 0x01, 0x02, 0x01, 0x71, 0x02, 0x1c,
+    0x02, 0x02, 0x00, 0xaa, 0x00, 0xfd, 0x03, 0x02, 0x00, 0xfd, 0x01, 0x71,
+    0x04, 0x05, 0x04, 0x06, 0x01, 0x02, 0x00, 0xaa, 0x00, 0xfd, 0x01, 0x02,
+    0x00, 0x00, 0x00, 0xaa, 0x02, 0x02, 0x00, 0xfd, 0x01, 0x71, 0x03, 0x02,
+    0x01, 0x71, 0x02, 0x1c, 0x04, 0x05, 0x04, 0x06, 0x01, 0x02, 0x00, 0xfd,
+    0x01, 0x71, 0x01, 0x02, 0x01, 0x71, 0x02, 0x1c, 0x02, 0x02, 0x00, 0x00,
+    0x00, 0xaa, 0x03, 0x02, 0x00, 0xaa, 0x00, 0xfd, 0x04, 0x05, 0x04, 0x06,
+    0x01, 0x02, 0x01, 0x71, 0x02, 0x1c, 0x01, 0x02, 0x00, 0xfd, 0x01, 0x71,
+    0x02, 0x02, 0x00, 0xaa, 0x00, 0xfd, 0x03, 0x02, 0x00, 0x00, 0x00, 0xaa,
+    0x04, 0x05, 0x04, 0x06, 0x01, 0x00,
+};
+
+// race, 14 bytes
+const uint8_t anim_prog_race[] PROGMEM = {
+    0x04, 0x01, 0x40, 0x13, 0x88, 0x01, 0x09, 0x00, 0x00, 0x05, 0x04, 0x06,
+    0x01, 0x00,
+};
+
+// sides, 68 bytes
+const uint8_t anim_prog_sides[] PROGMEM = {
+    0x08, 0x01, 0x20, 0x00, 0x14, 0x01, 0x02, 0x00, 0x00, 0x00, 0xaa, 0x01,
+    0x05, 0x04, 0x06, 0x02, 0x01, 0x02, 0x00, 0xaa, 0x00, 0xfd, 0x02, 0x05,
+    0x04, 0x06, 0x02, 0x01, 0x02, 0x00, 0xfd, 0x01, 0x71, 0x03, 0x05, 0x04,
+    0x06, 0x02, 0x01, 0x02, 0x01, 0x71, 0x02, 0x1c, 0x04, 0x05, 0x04, 0x06,
+    0x02, 0x07, 0x03, 0x01, 0x05, 0x04, 0x06, 0x01, 0x03, 0x00, 0x03, 0x01,
+    0x03, 0x02, 0x05, 0x04, 0x06, 0x01, 0x08, 0x00,
+};
+
+const uint8_t * const anim_programs[_N_ANIM] PROGMEM = {
+    anim_prog_wave, anim_prog_switch, anim_prog_race, anim_prog_sides,
+};
+
+#endif
@@ -0,0 +1,53 @@
+/*
+ * Timing markers for the cycle benchmark
+ *
+ * When TV_BENCH_MARKERS is defined, spare PORTC pins are
+ * held high while a section of code runs so that simavr
+ * (see sim/simbench.c) or a logic analyser can count the
+ * cycles spent in it.  Each marker costs one sbi/cbi.
+ * Without the define the markers compile to nothing.
+ *
+ * PC5 is the microphone input, so the sound marker is on
+ * a spare PORTB pin instead.  It is only set between
+ * transmits, which write the whole of PORTB.
+ */
+
+#ifndef BENCH_MARKERS_H_
+#define BENCH_MARKERS_H_
+
+#include <avr/io.h>
+#include "ws2812_config.h"
+
+// PORTC pin per marker
+#define BENCH_RENDER    0   // one pass of run_frame()
+#define BENCH_TRANSMIT  1   // ws2812_setleds()
+#define BENCH_UART      2   // USART receive interrupt
+#define BENCH_SPI_WAIT  3   // SPI output waiting for the data register
+#define BENCH_RASTER    4   // each primitive of fb_bench() at start up
+
+// PORTB pin of the window sound_window() analyses,
+// PB1 is a lane of the parallel output
+#if defined(ws2812_parallel)
+#define BENCH_SOUND     5
+#else
+#define BENCH_SOUND     1
+#endif
+
+#if defined(TV_BENCH_MARKERS)
+#define BENCH_MARK_INIT()    (DDRC |= (1 << BENCH_RENDER) | (1 << BENCH_TRANSMIT) | \
+                              (1 << BENCH_UART) | (1 << BENCH_SPI_WAIT) | \
+                              (1 << BENCH_RASTER), \
+                              DDRB |= (1 << BENCH_SOUND))
+#define BENCH_MARK_ON(pin)   (PORTC |= (1 << (pin)))
+#define BENCH_MARK_OFF(pin)  (PORTC &= ~(1 << (pin)))
+#define BENCH_MARK_B_ON(pin)  (PORTB |= (1 << (pin)))
+#define BENCH_MARK_B_OFF(pin) (PORTB &= ~(1 << (pin)))
+#else
+#define BENCH_MARK_INIT()
+#define BENCH_MARK_ON(pin)
+#define BENCH_MARK_OFF(pin)
+#define BENCH_MARK_B_ON(pin)
+#define BENCH_MARK_B_OFF(pin)
+#endif
+
+#endif /* BENCH_MARKERS_H_ */
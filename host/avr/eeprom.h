@@ -0,0 +1,43 @@
+/*
+ * Host stand-in for <avr/eeprom.h>
+ *
+ * The EEPROM is a byte array in host memory (see
+ * host_avr.c) which is always ready.  Every byte that
+ * is actually changed is counted, per cell in
+ * host_eeprom_wear and in total in host_eeprom_writes.
+ */
+
+#ifndef HOST_AVR_EEPROM_H_
+#define HOST_AVR_EEPROM_H_
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <avr/io.h>
+
+extern uint8_t host_eeprom[E2END + 1];
+extern uint32_t host_eeprom_wear[E2END + 1];
+extern uint32_t host_eeprom_writes;
+
+#define eeprom_is_ready() 1
+
+static inline uint8_t eeprom_read_byte(const uint8_t *addr)
+{
+    return host_eeprom[(uintptr_t)addr];
+}
+
+static inline void eeprom_read_block(void *dst, const void *src, size_t n)
+{
+    memcpy(dst, &host_eeprom[(uintptr_t)src], n);
+}
+
+static inline void eeprom_update_byte(uint8_t *addr, uint8_t value)
+{
+    if( host_eeprom[(uintptr_t)addr] != value ) {
+        host_eeprom[(uintptr_t)addr] = value;
+        host_eeprom_wear[(uintptr_t)addr]++;
+        host_eeprom_writes++;
+    }
+}
+
+#endif /* HOST_AVR_EEPROM_H_ */
@@ -0,0 +1,27 @@
+/*
+ * Host stand-in for <avr/interrupt.h>
+ *
+ * Interrupt handlers become ordinary functions which
+ * the host harness may call directly to inject events.
+ */
+
+#ifndef HOST_AVR_INTERRUPT_H_
+#define HOST_AVR_INTERRUPT_H_
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+
+#define sei() (SREG |= 0x80)
+#define cli() (SREG &= (uint8_t)~0x80)
+
+void USART_RX_vect(void);
+void USART_UDRE_vect(void);
+void TIMER0_COMPA_vect(void);
+void TIMER1_OVF_vect(void);
+void INT0_vect(void);
+void INT1_vect(void);
+void PCINT2_vect(void);
+void ADC_vect(void);
+
+#endif /* HOST_AVR_INTERRUPT_H_ */
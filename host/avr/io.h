@@ -0,0 +1,101 @@
+/*
+ * Host stand-in for <avr/io.h>
+ *
+ * Only the registers and bit names used by the TV sign
+ * firmware are provided.  Every register is a plain byte
+ * in host memory (see host_avr.c) so the pattern code
+ * can be compiled and run unmodified on Linux.
+ */
+
+#ifndef HOST_AVR_IO_H_
+#define HOST_AVR_IO_H_
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+
+extern volatile uint8_t SREG;
+
+extern volatile uint8_t PINB, DDRB, PORTB;
+extern volatile uint8_t PINC, DDRC, PORTC;
+extern volatile uint8_t PIND, DDRD, PORTD;
+
+extern volatile uint8_t EICRA, EIMSK, PCICR, PCMSK2;
+extern volatile uint8_t TCCR0A, TCCR0B, OCR0A, TIMSK0, TCNT0, TIFR0;
+extern volatile uint8_t TCCR1B, TIMSK1;
+
+extern volatile uint8_t UCSR0A, UCSR0B, UCSR0C;
+extern volatile uint8_t UBRR0H, UBRR0L, UDR0;
+
+extern volatile uint8_t ADMUX, ADCSRA, ADCSRB, ADCH, DIDR0;
+
+// port bits
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+// external and pin change interrupts
+#define INT0 0
+#define INT1 1
+#define ISC01 1
+#define ISC11 3
+#define PCIE2 2
+#define PCINT20 4
+
+// timer 0
+#define WGM01 1
+#define CS00 0
+#define CS01 1
+#define OCIE0A 1
+#define OCF0A 1
+
+// timer 1
+#define CS10 0
+#define CS11 1
+#define CS12 2
+#define TOIE1 0
+
+// USART 0
+#define U2X0 1
+#define DOR0 3
+#define UDRE0 5
+#define UDRIE0 5
+#define TXC0 6
+#define RXC0 7
+#define UCSZ00 1
+#define TXEN0 3
+#define RXEN0 4
+#define RXCIE0 7
+
+// ADC
+#define REFS0 6
+#define ADLAR 5
+#define ADEN 7
+#define ADSC 6
+#define ADATE 5
+#define ADIE 3
+#define ADPS0 0
+#define ADPS1 1
+#define ADPS2 2
+#define ADC5D 5
+
+// EEPROM, 1 KB on the atmega328p
+#define E2END 0x3FF
+
+// fuses
+#define HFUSE_DEFAULT 0xD9
+#define EFUSE_DEFAULT 0xFF
+
+typedef struct { uint8_t low; uint8_t high; uint8_t extended; } __fuse_t;
+#define FUSES __fuse_t __fuse
+
+#endif /* HOST_AVR_IO_H_ */
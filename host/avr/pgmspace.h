@@ -0,0 +1,19 @@
+/*
+ * Host stand-in for <avr/pgmspace.h>
+ *
+ * There is a single address space on the host, so flash
+ * reads are ordinary loads.
+ */
+
+#ifndef HOST_AVR_PGMSPACE_H_
+#define HOST_AVR_PGMSPACE_H_
+
+#include <stdint.h>
+
+#define PROGMEM
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+
+#endif /* HOST_AVR_PGMSPACE_H_ */
@@ -0,0 +1,141 @@
+/*
+ * Host implementation of the AVR registers and
+ * the light_ws2812 output functions
+ */
+
+#include <string.h>
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <util/delay.h>
+#include "host_avr.h"
+
+// registers
+volatile uint8_t SREG;
+volatile uint8_t PINB, DDRB, PORTB;
+volatile uint8_t PINC, DDRC, PORTC;
+volatile uint8_t PIND, DDRD, PORTD;
+volatile uint8_t EICRA, EIMSK, PCICR, PCMSK2;
+volatile uint8_t TCCR0A, TCCR0B, OCR0A, TIMSK0, TCNT0, TIFR0;
+volatile uint8_t TCCR1B, TIMSK1;
+// the USART always reports a received byte
+// and an empty transmit buffer so polling never blocks
+volatile uint8_t UCSR0A = (1 << RXC0) | (1 << UDRE0);
+volatile uint8_t UCSR0B, UCSR0C;
+volatile uint8_t UBRR0H, UBRR0L, UDR0;
+// the harness puts a sample in ADCH and
+// calls ADC_vect()
+volatile uint8_t ADMUX, ADCSRA, ADCSRB, ADCH, DIDR0;
+
+double host_delay_us = 0;
+
+// an erased EEPROM reads all ones
+uint8_t host_eeprom[E2END + 1] = { [0 ... E2END] = 0xff };
+uint32_t host_eeprom_wear[E2END + 1];
+uint32_t host_eeprom_writes = 0;
+
+struct cRGB host_frame[HOST_MAX_LED];
+uint16_t host_frame_leds = 0;
+uint32_t host_frame_count = 0;
+uint32_t host_leds_sent = 0;
+void (*host_frame_hook)(const struct cRGB *frame, uint16_t leds) = 0;
+
+// count the frame now in host_frame
+static void host_latch(uint16_t leds, uint16_t sent)
+{
+    if( leds > host_frame_leds ) {
+        host_frame_leds = leds;
+    }
+    host_leds_sent += sent;
+    host_frame_count++;
+    if( host_frame_hook ) {
+        host_frame_hook(host_frame, host_frame_leds);
+    }
+}
+
+static uint8_t host_index(const uint8_t *indices, uint16_t n)
+{
+    uint8_t pair = indices[n >> 1];
+    return (n & 1) ? pair >> 4 : pair & 0x0f;
+}
+
+void ws2812_sendarray_mask(uint8_t *data, uint16_t datlen, uint8_t pinmask)
+{
+    uint16_t leds = datlen / 3;
+    if( leds > HOST_MAX_LED ) {
+        leds = HOST_MAX_LED;
+    }
+    memcpy(host_frame, data, leds * sizeof(struct cRGB));
+    host_latch(leds, leds);
+}
+
+void ws2812_sendpalette_mask(uint8_t *indices, uint16_t leds, struct cRGB *palette, uint8_t pinmask)
+{
+    if( leds > HOST_MAX_LED ) {
+        leds = HOST_MAX_LED;
+    }
+    for( uint16_t il = 0; il < leds; il++ ) {
+        host_frame[il] = palette[host_index(indices, il)];
+    }
+    host_latch(leds, leds);
+}
+
+void ws2812_setleds_palette(uint8_t *indices, uint16_t leds, struct cRGB *palette)
+{
+    ws2812_sendpalette_mask(indices, leds, palette, _BV(ws2812_pin));
+    _delay_us(ws2812_resettime);
+}
+
+void ws2812_sendarray(uint8_t *data, uint16_t datlen)
+{
+    ws2812_sendarray_mask(data, datlen, _BV(ws2812_pin));
+}
+
+void ws2812_setleds_pin(struct cRGB *ledarray, uint16_t leds, uint8_t pinmask)
+{
+    ws2812_sendarray_mask((uint8_t*)ledarray, leds+leds+leds, pinmask);
+    _delay_us(ws2812_resettime);
+}
+
+void ws2812_setleds(struct cRGB *ledarray, uint16_t leds)
+{
+    ws2812_setleds_pin(ledarray, leds, _BV(ws2812_pin));
+}
+
+#if defined(ws2812_parallel)
+// the lanes are captured back to back, each as long as
+// the longest lane sent so far
+static uint16_t host_lane_leds = 0;
+
+void ws2812_setleds_parallel(struct cRGB *lane0, struct cRGB *lane1,
+                             struct cRGB *lane2, struct cRGB *lane3, uint16_t leds)
+{
+    struct cRGB *lanes[4] = {lane0, lane1, lane2, lane3};
+    if( leds > host_lane_leds ) {
+        host_lane_leds = leds;
+    }
+    for( int i = 0; i < 4; i++ ) {
+        for( uint16_t il = 0; il < leds && i*host_lane_leds + il < HOST_MAX_LED; il++ ) {
+            host_frame[i*host_lane_leds + il] = lanes[i][il];
+        }
+    }
+    host_latch(4*host_lane_leds, leds);
+    _delay_us(ws2812_resettime);
+}
+
+void ws2812_setleds_palette_parallel(uint8_t *indices, uint16_t lane0, uint16_t lane1,
+                                     uint16_t lane2, uint16_t lane3, uint16_t leds,
+                                     struct cRGB *palette)
+{
+    uint16_t lanes[4] = {lane0, lane1, lane2, lane3};
+    if( leds > host_lane_leds ) {
+        host_lane_leds = leds;
+    }
+    for( int i = 0; i < 4; i++ ) {
+        for( uint16_t il = 0; il < leds && i*host_lane_leds + il < HOST_MAX_LED; il++ ) {
+            host_frame[i*host_lane_leds + il] = palette[host_index(indices, lanes[i] + il)];
+        }
+    }
+    host_latch(4*host_lane_leds, leds);
+    _delay_us(ws2812_resettime);
+}
+#endif
@@ -0,0 +1,35 @@
+/*
+ * Host harness interface
+ *
+ * Frame sink used in place of the WS2812 bit-banging
+ * routines when the firmware is built for Linux.  Every
+ * latched frame is copied into host_frame and counted.
+ * Like a real chain, LEDs past the end of a short frame
+ * keep the color they were last sent.
+ */
+
+#ifndef HOST_AVR_H_
+#define HOST_AVR_H_
+
+#include <stdint.h>
+#include "light_ws2812.h"
+
+// largest chain the sink will capture
+#define HOST_MAX_LED 1024
+
+// colors the chain shows after the last latched frame,
+// and the length of the longest frame sent so far
+extern struct cRGB host_frame[HOST_MAX_LED];
+extern uint16_t host_frame_leds;
+
+// number of frames latched since start
+extern uint32_t host_frame_count;
+
+// LEDs clocked out since start, per lane for the
+// parallel output
+extern uint32_t host_leds_sent;
+
+// optional callback run after every latched frame
+extern void (*host_frame_hook)(const struct cRGB *frame, uint16_t leds);
+
+#endif /* HOST_AVR_H_ */
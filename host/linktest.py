@@ -0,0 +1,106 @@
+"""
+Check LinkDaemon against a stand-in for the sign
+
+A thread plays the sign on a pseudo-terminal: it
+answers 0xa7, 2 with a 1 after a delay that the
+check sets, and 0x4a, 0x05 with a counters record.
+The daemon talks to it through a SerialLink, and
+the checks send their requests to the daemon
+directly and through a DaemonLink on a socket.
+
+The late answer check lets a request time out and
+the sign answer afterwards.  The next request must
+get its own answer, not the late byte.
+
+usage: python3 host/linktest.py
+exits with 1 if any check failed
+"""
+
+import os
+import sys
+import tempfile
+import threading
+import time
+import tty
+
+sys.path.insert(0, os.path.join(os.path.dirname(os.path.abspath(__file__)), '..'))
+import tvlink
+
+# the counters record of 0x4a, 0x05, see tvstats.h
+STATS_RECORD = bytes([25, 1]) + bytes(range(24))
+
+class StandIn(threading.Thread):
+    """ the sign, on the master side of a pty """
+
+    def __init__(self):
+        super().__init__(daemon=True)
+        self.master, slave = os.openpty()
+        tty.setraw(self.master)
+        self.path = os.ttyname(slave)
+        self.slave = slave
+        # seconds before the answer to 0xa7, 2
+        self.delay = 0
+
+    def read(self, n):
+        data = b''
+        while len(data) < n:
+            data += os.read(self.master, n - len(data))
+        return data
+
+    def run(self):
+        while True:
+            cmd = self.read(2)
+            if cmd == b'\xa7\x02':
+                time.sleep(self.delay)
+                os.write(self.master, b'\x01')
+            elif cmd == b'\x4a\x05':
+                os.write(self.master, STATS_RECORD)
+
+def check(name, ok, got):
+    print('%-24s %-40s %8s' % (name, got, 'ok' if ok else 'FAIL'))
+    return 0 if ok else 1
+
+def main():
+    sign = StandIn()
+    sign.start()
+    daemon = tvlink.LinkDaemon(lambda: tvlink.SerialLink(sign.path))
+    # keep the daemon log out of the table
+    tvlink.log = lambda msg: None
+    bad = 0
+
+    print('%-24s %-40s %8s' % ('link check', 'answer', 'check'))
+    reply = daemon.execute(b'\xa7\x02', 1, 1.0)
+    bad += check('show', reply.get('data') == '01', reply.get('data', reply))
+
+    reply = daemon.execute(b'\x4a\x05', len(STATS_RECORD), 1.0)
+    bad += check('stats', reply.get('data') == STATS_RECORD.hex(),
+                 reply.get('data', reply)[:16])
+
+    # the answer comes 0.3 s after its request gave up
+    sign.delay = 0.5
+    reply = daemon.execute(b'\xa7\x02', 1, 0.2)
+    bad += check('timeout', reply.get('error') == 'timeout', reply.get('error'))
+    time.sleep(0.5)
+    sign.delay = 0
+    reply = daemon.execute(b'\x4a\x05', len(STATS_RECORD), 1.0)
+    bad += check('after late answer', reply.get('data') == STATS_RECORD.hex(),
+                 reply.get('data', reply)[:16])
+
+    # the same through the socket
+    path = os.path.join(tempfile.mkdtemp(), 'tvsign.sock')
+    threading.Thread(target=daemon.serve, args=(path,), daemon=True).start()
+    end = time.time() + 5
+    while not os.path.exists(path) and time.time() < end:
+        time.sleep(0.01)
+    link = tvlink.DaemonLink(path)
+    link.settimeout(1.0)
+    link.send(b'\xa7\x02')
+    got = link.recv(1)
+    bad += check('socket', got == b'\x01', got.hex())
+    link.s.close()
+
+    print('PASS' if not bad else 'FAIL')
+    return 1 if bad else 0
+
+if __name__ == '__main__':
+    sys.exit(main())
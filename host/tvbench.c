@@ -0,0 +1,597 @@
+/*
+ * Frame throughput benchmark for the pattern engine
+ *
+ * Runs every pattern of tvpatterns.c for a fixed number
+ * of loop iterations against the host frame sink and
+ * reports the frames latched, the share of frames not
+ * sent because they were unchanged, the LEDs clocked out
+ * per frame sent, frames per second,
+ * nanoseconds per frame and per loop iteration.  Time requested through
+ * _delay_ms/_delay_us is reported separately and is
+ * not included in the render time.
+ *
+ * The animations of anim_programs.h follow the built-in
+ * patterns, so the interpreted wave, switch and race
+ * can be compared with the C versions.
+ *
+ * A second table times one step of the race trains for
+ * a range of widths, drawn incrementally as run_race
+ * does and redrawn in full as before.
+ *
+ * The fade table times the frames of the cross-fade after
+ * a pattern change against the same frames cut in at once.
+ *
+ * The sound pattern is fed a tone and a bass kick through
+ * the ADC interrupt.  The sound table checks that a tone
+ * on each band lights its own side, counts the beats of a
+ * kick and times the analysis of a window.
+ *
+ * The settings table saves through the EEPROM ring of
+ * tvsettings.c: a burst of changes makes one record,
+ * every save is read back as after a power cycle, a save
+ * cut short leaves the one before it, and a preset comes
+ * back as saved.  It reports the bytes written and the
+ * most writes any one cell took.
+ *
+ * The brightness table shows the palette as it is sent at
+ * each brightness step and checks that the four colors
+ * stay apart and keep every channel they light.
+ *
+ * The raster table times the frame buffer primitives per
+ * LED, next to a loop setting one LED at a time and the
+ * RGB loop the patterns used before the palette buffer.
+ *
+ * The last table checks the delta coded race geometry
+ * against the tables of race_steps.h in both directions
+ * and compares walking it with indexing the tables.
+ *
+ * usage: tvbench [iterations]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include <string.h>
+#include <time.h>
+#include <avr/interrupt.h>
+#include <avr/eeprom.h>
+#include <avr/pgmspace.h>
+#include <util/delay.h>
+#include "host_avr.h"
+#include "tvframe.h"
+#include "tvsound.h"
+#include "tvsettings.h"
+#include "race_steps.h"
+#include "anim_programs.h"
+
+// tvpatterns.h is not included since its random()
+// collides with the C library declaration
+void run_frame(void);
+void set_pattern(uint8_t pat);
+void race_advance(int direction);
+void race_draw(uint8_t thickness, int direction);
+void race_move(uint8_t thickness, int direction);
+
+#define _N_BUILTIN 8
+#define _N_PAT (_N_BUILTIN + _N_ANIM)
+#define _SOUND_PATTERN 7
+#define _MAX_BRIGHTNESS 4
+
+extern int ipat;
+extern uint16_t istep;
+extern uint8_t DELAY;
+extern const uint8_t nom_delays[];
+extern int disable_auto_update;
+extern int stop_updates;
+extern uint8_t race_width;
+extern volatile uint16_t fb_sent;
+extern volatile uint16_t fb_elided;
+extern const uint16_t brightness_scale[_MAX_BRIGHTNESS + 1];
+
+static const char *pattern_names[_N_PAT] = {
+    "turnon", "wave", "switch", "breathe", "race", "race_rev", "sparkle", "sound",
+    _ANIM_NAMES
+};
+
+static double now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+// render time of one race step, without the transmit
+static void race_steps(long steps)
+{
+    static const uint8_t widths[] = {1, 5, 10, 20, 30, 40, 50, 60};
+
+    printf("\n%-12s %10s %14s %14s\n", "race width", "steps", "ns/step", "ns/redraw");
+    for( unsigned i = 0; i < sizeof(widths); i++ ) {
+        uint8_t w = widths[i];
+
+        fb_clear();
+        race_draw(w, 0);
+        double start = now_ns();
+        for( long it = 0; it < steps; it++ ) {
+            race_advance(0);
+            race_move(w, 0);
+        }
+        double moved = now_ns() - start;
+
+        start = now_ns();
+        for( long it = 0; it < steps; it++ ) {
+            race_advance(0);
+            fb_clear();
+            race_draw(w, 0);
+        }
+        double redrawn = now_ns() - start;
+
+        printf("%-12u %10ld %14.0f %14.0f\n", w, steps, moved / steps, redrawn / steps);
+    }
+}
+
+// render time of the frames of a cross-fade
+static void fades(long rounds)
+{
+    static const uint8_t pairs[][2] = {{1, 4}, {4, 2}, {2, 6}, {6, 3}, {3, 8}};
+    const int frames = 15;
+
+    printf("\n%-16s %10s %14s %14s\n", "fade", "frames", "ns/fading", "ns/cut");
+    for( unsigned i = 0; i < sizeof(pairs)/sizeof(pairs[0]); i++ ) {
+        double times[2] = {0, 0};
+        for( int cut = 0; cut < 2; cut++ ) {
+            for( long r = 0; r < rounds; r++ ) {
+                set_pattern(pairs[i][0]);
+                for( int it = 0; it < 40; it++ ) {
+                    run_frame();
+                }
+                set_pattern(pairs[i][1]);
+                if( cut ) {
+                    fb_fade(0);
+                }
+                double start = now_ns();
+                for( int it = 0; it < frames; it++ ) {
+                    run_frame();
+                }
+                times[cut] += now_ns() - start;
+            }
+        }
+        char name[24];
+        snprintf(name, sizeof(name), "%s>%s", pattern_names[pairs[i][0]],
+                 pattern_names[pairs[i][1]]);
+        printf("%-16s %10ld %14.0f %14.0f\n", name, rounds * frames,
+               times[0] / (rounds * frames), times[1] / (rounds * frames));
+    }
+}
+
+// The palette as sent at every brightness step,
+// at the level of the patterns and at the first
+// level of the turn-on ramp
+static int brightness_steps(void)
+{
+    static const uint8_t levels[] = {4, 1};
+    int bad = 0;
+
+    printf("\n%-12s %6s %-36s %8s\n", "brightness", "level",
+           "violet beige yellow cyan", "check");
+    fb_fade(0);
+    for( unsigned il = 0; il < sizeof(levels); il++ ) {
+        for( uint8_t b = 1; b <= _MAX_BRIGHTNESS; b++ ) {
+            uint8_t level = levels[il];
+            fb_brightness(pgm_read_word(&brightness_scale[b]));
+            for( uint8_t ic = 1; ic < _N_COLORS; ic++ ) {
+                fb_fill((ic - 1) * 10, ic * 10, ic);
+            }
+            show_leds(level);
+
+            int ok = 1;
+            char colors[40] = "";
+            for( uint8_t ic = 1; ic < _N_COLORS; ic++ ) {
+                const struct cRGB *c = &host_frame[(ic - 1) * 10];
+                char one[16];
+                snprintf(one, sizeof(one), "%u,%u,%u ", c->r, c->g, c->b);
+                strcat(colors, one);
+                // a lit channel must stay lit
+                ok &= (c->r != 0) == (palette[ic][0] != 0) &&
+                      (c->g != 0) == (palette[ic][1] != 0) &&
+                      (c->b != 0) == (palette[ic][2] != 0);
+                for( uint8_t jc = 1; jc < ic; jc++ ) {
+                    const struct cRGB *d = &host_frame[(jc - 1) * 10];
+                    ok &= c->r != d->r || c->g != d->g || c->b != d->b;
+                }
+            }
+            printf("%-12u %6u %-36s %8s\n", b, level, colors, ok ? "ok" : "FAIL");
+            bad += !ok;
+        }
+    }
+    fb_brightness(_FULL_SCALE);
+    fb_clear();
+    return bad;
+}
+
+// Sound input
+//
+// The samples go in through ADC_vect as the ADC
+// would deliver them, a tone of freq Hz and a
+// decaying 150 Hz kick every kick samples
+static uint32_t sound_n = 0;
+
+static void sound_feed(int samples, double freq, int kick)
+{
+    for( int i = 0; i < samples; i++, sound_n++ ) {
+        double x = 0;
+        if( freq > 0 ) {
+            x += 60 * sin(2 * M_PI * freq * sound_n / _SOUND_RATE);
+        }
+        if( kick ) {
+            int age = sound_n % kick;
+            x += 100 * exp(-age / 400.0) * sin(2 * M_PI * 150 * age / _SOUND_RATE);
+        }
+        int v = 128 + (int)x;
+        ADCH = v < 0 ? 0 : v > 255 ? 255 : v;
+        ADC_vect();
+    }
+}
+
+// band levels for a tone on every band, the
+// beats of a kick twice a second and the time
+// of one window
+static int sound(long windows)
+{
+    static const uint8_t bins[_SOUND_BANDS] = {1, 3, 8, 20};
+    int bad = 0;
+
+    printf("\n%-12s %10s %14s %8s\n", "sound tone", "Hz", "levels", "check");
+    for( uint8_t band = 0; band < _SOUND_BANDS; band++ ) {
+        double freq = (double)bins[band] * _SOUND_RATE / _SOUND_WINDOW;
+        sound_start();
+        for( int w = 0; w < 30; w++ ) {
+            sound_feed(_SOUND_WINDOW, freq, 0);
+            sound_window();
+        }
+        int ok = 1;
+        for( uint8_t b = 0; b < _SOUND_BANDS; b++ ) {
+            if( b == band ? sound_level[b] != 3 : sound_level[b] > 1 ) {
+                ok = 0;
+            }
+        }
+        bad += !ok;
+        char levels[16];
+        snprintf(levels, sizeof(levels), "%u %u %u %u", sound_level[0], sound_level[1],
+                 sound_level[2], sound_level[3]);
+        printf("band %-7u %10.0f %14s %8s\n", band, freq, levels, ok ? "ok" : "FAIL");
+    }
+
+    // a kick every half second
+    int kick = _SOUND_RATE / 2;
+    int kicks = 8;
+    int beats = 0;
+    sound_start();
+    sound_n = 0;
+    for( long w = 0; w < (long)kicks * kick / _SOUND_WINDOW; w++ ) {
+        sound_feed(_SOUND_WINDOW, 1200, kick);
+        sound_window();
+        beats += sound_beat;
+    }
+    bad += beats != kicks;
+
+    double elapsed = 0;
+    for( long w = 0; w < windows; w++ ) {
+        sound_feed(_SOUND_WINDOW, 450, kick);
+        double start = now_ns();
+        sound_window();
+        elapsed += now_ns() - start;
+    }
+    sound_stop();
+
+    printf("%-12s %10s %14s %8s\n", "kicks", "beats", "ns/window", "check");
+    printf("%-12d %10d %14.0f %8s\n", kicks, beats, elapsed / windows,
+           beats == kicks ? "ok" : "FAIL");
+    return bad;
+}
+
+// run the settings writer until it is idle, it
+// writes a byte per call as the host EEPROM is
+// always ready
+static void settings_flush(uint16_t now)
+{
+    for( uint8_t i = 0; i <= _SETTINGS_RECORD; i++ ) {
+        settings_poll(now);
+    }
+}
+
+static uint32_t ring_wear(void)
+{
+    uint32_t most = 0;
+    for( uint16_t a = _SETTINGS_RING; a < _SETTINGS_PRESET; a++ ) {
+        if( host_eeprom_wear[a] > most ) {
+            most = host_eeprom_wear[a];
+        }
+    }
+    return most;
+}
+
+// print a row, failing it as well if a byte of
+// the ring was written more often than an even
+// spread of the saves allows, 1 if it failed
+static int settings_row(const char *name, long changes, uint16_t records,
+                        uint32_t bytes, int ok)
+{
+    uint32_t wear = ring_wear();
+    uint32_t most = (settings_saves + _SETTINGS_SLOTS - 1) / _SETTINGS_SLOTS + 1;
+    ok = ok && wear <= most;
+    printf("%-12s %10ld %10u %10u %10u %8s\n", name, changes, records, bytes,
+           wear, ok ? "ok" : "FAIL");
+    return !ok;
+}
+
+// saves through the EEPROM ring, each read back
+// as the firmware does at start up
+static int settings(long saves)
+{
+    struct settings s;
+    uint16_t now = 0;
+    int bad = 0;
+    uint8_t saved_width = race_width;
+
+    printf("\n%-12s %10s %10s %10s %10s %8s\n", "settings", "changes", "records",
+           "bytes", "max wear", "check");
+
+    // a burst of changes ten milliseconds apart
+    settings_load(&s);
+    uint16_t records = settings_saves;
+    uint32_t bytes = host_eeprom_writes;
+    for( int i = 0; i < 100; i++ ) {
+        race_width = i % 50;
+        settings_changed(now);
+        now += 10;
+        settings_poll(now);
+    }
+    for( int i = 0; i < 1000; i++ ) {
+        now += 10;
+        settings_poll(now);
+    }
+    int ok = settings_saves - records == 1 && settings_load(&s) && s.race_width == 49;
+    bad += settings_row("burst", 100, settings_saves - records, host_eeprom_writes - bytes, ok);
+
+    // every save survives a power cycle
+    records = settings_saves;
+    bytes = host_eeprom_writes;
+    ok = 1;
+    for( long i = 0; i < saves; i++ ) {
+        race_width = 1 + i % 50;
+        settings_changed(now);
+        now += _SETTINGS_HOLD_MS;
+        settings_flush(now);
+        if( !settings_load(&s) || s.race_width != race_width ) {
+            ok = 0;
+        }
+    }
+    bad += settings_row("ring", saves, settings_saves - records, host_eeprom_writes - bytes, ok);
+
+    // power lost four bytes into a save
+    records = settings_saves;
+    bytes = host_eeprom_writes;
+    uint8_t last = race_width;
+    race_width = last + 1;
+    settings_changed(now);
+    now += _SETTINGS_HOLD_MS;
+    for( int i = 0; i < 5; i++ ) {
+        settings_poll(now);
+    }
+    ok = settings_load(&s) && s.race_width == last;
+    bad += settings_row("torn", 1, settings_saves - records, host_eeprom_writes - bytes, ok);
+
+    // a preset comes back, one never saved does not
+    records = settings_saves;
+    bytes = host_eeprom_writes;
+    race_width = 21;
+    settings_save_preset(3);
+    settings_flush(now);
+    race_width = saved_width;
+    ok = settings_load_preset(3, &s) && s.race_width == 21 && !settings_load_preset(4, &s);
+    bad += settings_row("preset", 1, settings_saves - records, host_eeprom_writes - bytes, ok);
+
+    return bad;
+}
+
+// the RGB loop of the patterns before the palette,
+// reloading the volatile color and level per LED
+static struct cRGB rgb[_MAX_LED];
+static volatile uint8_t rgb_color[3] = {8, 3, 0};
+static volatile uint8_t rgb_level = 4;
+
+static void rgb_loop(void)
+{
+    for( int il = 0; il < _MAX_LED; il++ ) {
+        rgb[il].r = rgb_color[0]*rgb_level;
+        rgb[il].g = rgb_color[1]*rgb_level;
+        rgb[il].b = rgb_color[2]*rgb_level;
+    }
+}
+
+static void raster_fill(void) { fb_fill(0, _MAX_LED, _CYAN); }
+static void raster_copy(void) { fb_copy(_MAX_LED / 2, 0, _MAX_LED / 2); }
+static void raster_copy_odd(void) { fb_copy(_MAX_LED / 2 + 1, 0, _MAX_LED / 2 - 1); }
+
+static void raster_set(void)
+{
+    for( uint16_t il = 0; il < _MAX_LED; il++ ) {
+        fb_set(il, _YELLOW);
+    }
+}
+
+// primitives in the order of fb_bench() in tvframe.c
+static const struct {
+    const char *name;
+    void (*run)(void);
+    int leds;
+} rasters[] = {
+    {"fill", raster_fill, _MAX_LED},
+    {"clear", fb_clear, _MAX_LED},
+    {"sides", fb_sides, _MAX_LED},
+    {"copy", raster_copy, _MAX_LED / 2},
+    {"copy+1", raster_copy_odd, _MAX_LED / 2 - 1},
+    {"set loop", raster_set, _MAX_LED},
+    {"rgb loop", rgb_loop, _MAX_LED},
+};
+
+// time of each primitive per LED.  A byte of
+// the frame is read back after every call, so
+// the calls cannot be folded into one
+static void raster(long calls)
+{
+    volatile uint8_t sink = 0;
+
+    printf("\n%-12s %10s %10s %14s %14s\n", "primitive", "calls", "leds", "ns/call", "ns/led");
+    for( unsigned i = 0; i < sizeof(rasters)/sizeof(rasters[0]); i++ ) {
+        double start = now_ns();
+        for( long it = 0; it < calls; it++ ) {
+            rasters[i].run();
+            sink += led[it % _FB_BYTES];
+        }
+        double elapsed = now_ns() - start;
+        printf("%-12s %10ld %10d %14.0f %14.2f\n", rasters[i].name, calls, rasters[i].leds,
+               elapsed / calls, elapsed / calls / rasters[i].leds);
+    }
+    fb_clear();
+}
+
+// the uncoded race tables in the order of race_tables
+static const uint16_t (*const race_words[_N_RACE_TABLES])[3] = {
+    steps_race_violet, steps_race_beige, steps_race_yellow, steps_race_cyan,
+};
+static const char *race_names[_N_RACE_TABLES] = {"violet", "beige", "yellow", "cyan"};
+
+// check the race geometry and time one step of a
+// cursor against reading a step from the tables
+static int race_geometry(long steps)
+{
+    int bad = 0;
+    volatile uint16_t sink = 0;
+
+    printf("\n%-12s %10s %10s %14s %14s %8s\n",
+           "race table", "steps", "laps", "ns/next", "ns/indexed", "check");
+    for( uint8_t t = 0; t < _N_RACE_TABLES; t++ ) {
+        const uint16_t (*rows)[3] = race_words[t];
+        uint8_t n = race_rows(t);
+        int ok = 1;
+
+        // three laps forward, then three back
+        struct race_cursor c;
+        race_start(&c, t);
+        for( int i = 0; i < 6 * n; i++ ) {
+            if( i >= 3 * n ) {
+                race_prev(&c);
+            }
+            int row = i < 3 * n ? i % n : (6 * n - 1 - i) % n;
+            for( int col = 0; col < 3; col++ ) {
+                if( c.row != row || c.led[col] != pgm_read_word(&rows[row][col]) ) {
+                    ok = 0;
+                }
+            }
+            if( i < 3 * n ) {
+                race_next(&c);
+            }
+        }
+        bad += !ok;
+
+        long laps = steps / n + 1;
+        race_start(&c, t);
+        double start = now_ns();
+        for( long i = 0; i < laps * n; i++ ) {
+            race_next(&c);
+            sink += c.led[0] + c.led[1] + c.led[2];
+        }
+        double walked = now_ns() - start;
+
+        start = now_ns();
+        uint8_t row = 0;
+        for( long i = 0; i < laps * n; i++ ) {
+            if( ++row == n ) {
+                row = 0;
+            }
+            sink += pgm_read_word(&rows[row][0]) + pgm_read_word(&rows[row][1]) +
+                    pgm_read_word(&rows[row][2]);
+        }
+        double indexed = now_ns() - start;
+
+        printf("%-12s %10u %10ld %14.1f %14.1f %8s\n", race_names[t], n, laps,
+               walked / (laps * n), indexed / (laps * n), ok ? "ok" : "FAIL");
+    }
+    return bad;
+}
+
+int main(int argc, char **argv)
+{
+    long iterations = 20000;
+    if( argc > 1 ) {
+        iterations = atol(argv[1]);
+    }
+
+    // patterns must not hand over to the next one
+    // while they are being measured
+    disable_auto_update = 1;
+
+    printf("%-12s %10s %10s %8s %10s %12s %12s %10s %12s\n",
+           "pattern", "iterations", "frames", "elided", "leds/frame",
+           "frames/s", "ns/frame", "ns/iter", "delay_ms");
+
+    for( int pat = 0; pat < _N_PAT; pat++ ) {
+        if( pat >= _N_BUILTIN ) {
+            set_pattern(pat);
+        }
+        else {
+            ipat = pat;
+            istep = 0;
+            stop_updates = 0;
+            DELAY = nom_delays[pat];
+        }
+
+        uint32_t frames_start = host_frame_count;
+        uint32_t leds_start = host_leds_sent;
+        uint16_t shown_start = fb_sent + fb_elided;
+        uint16_t elided_start = fb_elided;
+        host_delay_us = 0;
+
+        // the sound pattern hears a tone and a kick,
+        // a frame's worth of samples at a time
+        double elapsed = 0;
+        double start = now_ns();
+        for( long it = 0; it < iterations; it++ ) {
+            if( pat == _SOUND_PATTERN ) {
+                elapsed += now_ns() - start;
+                sound_feed(_SOUND_RATE / 50, 1200, _SOUND_RATE / 2);
+                start = now_ns();
+            }
+            run_frame();
+        }
+        elapsed += now_ns() - start;
+
+        uint32_t frames = host_frame_count - frames_start;
+        uint16_t shown = fb_sent + fb_elided - shown_start;
+        uint16_t elided = fb_elided - elided_start;
+        uint32_t leds = host_leds_sent - leds_start;
+        char name[16];
+        snprintf(name, sizeof(name), "%s%s", pat >= _N_BUILTIN ? "anim:" : "",
+                 pattern_names[pat]);
+        printf("%-12s %10ld %10u %7.1f%% %10.1f %12.0f %12.0f %10.0f %12.1f\n",
+               name, iterations, frames,
+               shown ? 100.0 * elided / shown : 0.0,
+               frames ? (double)leds / frames : 0.0,
+               frames ? frames / (elapsed * 1e-9) : 0.0,
+               frames ? elapsed / frames : 0.0,
+               elapsed / iterations,
+               host_delay_us / 1000.0);
+    }
+
+    race_steps(iterations);
+    fades(iterations / 100);
+    raster(iterations);
+    int bad = brightness_steps();
+    bad += sound(iterations);
+    bad += settings(iterations / 10);
+    bad += race_geometry(iterations);
+
+    return bad ? 1 : 0;
+}
@@ -0,0 +1,71 @@
+/*
+ * Frame dump of the patterns
+ *
+ * Runs one pattern of tvpatterns.c against the host
+ * frame sink and prints every frame sent as a line of
+ * palette indices, one digit per LED.  This is the
+ * format send_cmd.py --stream plays and tvcodec.py
+ * measures.
+ *
+ * usage: tvdump pattern [iterations] [race width]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "host_avr.h"
+#include "tvframe.h"
+
+// tvpatterns.h is not included since its random()
+// collides with the C library declaration
+void run_frame(void);
+void set_pattern(uint8_t pat);
+
+// first animation pattern, see tvpatterns.c
+#define _N_BUILTIN 8
+
+extern int ipat;
+extern uint16_t istep;
+extern uint8_t DELAY;
+extern const uint8_t nom_delays[];
+extern int disable_auto_update;
+extern int stop_updates;
+extern uint8_t race_width;
+
+static void print_frame(const struct cRGB *frame, uint16_t leds)
+{
+    for( uint16_t il = 0; il < _MAX_LED; il++ ) {
+        putchar('0' + fb_get(il));
+    }
+    putchar('\n');
+}
+
+int main(int argc, char **argv)
+{
+    if( argc < 2 ) {
+        fprintf(stderr, "usage: %s pattern [iterations] [race width]\n", argv[0]);
+        return 1;
+    }
+    long iterations = argc > 2 ? atol(argv[2]) : 2000;
+
+    disable_auto_update = 1;
+    int pat = atoi(argv[1]);
+    if( pat >= _N_BUILTIN ) {
+        set_pattern(pat);
+    }
+    else {
+        ipat = pat;
+        istep = 0;
+        stop_updates = 0;
+        DELAY = nom_delays[ipat];
+    }
+    if( argc > 3 ) {
+        race_width = atoi(argv[3]);
+    }
+
+    host_frame_hook = print_frame;
+    for( long it = 0; it < iterations; it++ ) {
+        run_frame();
+    }
+
+    return 0;
+}
@@ -0,0 +1,17 @@
+/*
+ * Host stand-in for <util/delay.h>
+ *
+ * Delays do not sleep.  The requested time is added to
+ * host_delay_us so the benchmark can report it separately
+ * from the time spent rendering.
+ */
+
+#ifndef HOST_UTIL_DELAY_H_
+#define HOST_UTIL_DELAY_H_
+
+extern double host_delay_us;
+
+static inline void _delay_us(double us) { host_delay_us += us; }
+static inline void _delay_ms(double ms) { host_delay_us += ms * 1000.0; }
+
+#endif /* HOST_UTIL_DELAY_H_ */
@@ -11,6 +11,7 @@
 */
 
 #include "light_ws2812.h"
+#include "bench_markers.h"
 #include <avr/interrupt.h>
 #include <avr/io.h>
 #include <util/delay.h>
@@ -23,8 +24,14 @@ void inline ws2812_setleds(struct cRGB *ledarray, uint16_t leds)
 
 void inline ws2812_setleds_pin(struct cRGB *ledarray, uint16_t leds, uint8_t pinmask)
 {
+  BENCH_MARK_ON(BENCH_TRANSMIT);
+#if defined(ws2812_spi)
+  ws2812_sendarray_spi((uint8_t*)ledarray,leds+leds+leds);
+#else
   ws2812_sendarray_mask((uint8_t*)ledarray,leds+leds+leds,pinmask);
+#endif
   _delay_us(ws2812_resettime);
+  BENCH_MARK_OFF(BENCH_TRANSMIT);
 }
 
 // Setleds for SK6812RGBW
@@ -34,11 +41,192 @@ void inline ws2812_setleds_rgbw(struct cRGBW *ledarray, uint16_t leds)
   _delay_us(ws2812_resettime);
 }
 
+// Setleds for palette indexed LEDs
+void ws2812_setleds_palette(uint8_t *indices, uint16_t leds, struct cRGB *palette)
+{
+  BENCH_MARK_ON(BENCH_TRANSMIT);
+#if defined(ws2812_spi)
+  ws2812_sendpalette_spi(indices,leds,palette);
+#else
+  ws2812_sendpalette_mask(indices,leds,palette,_BV(ws2812_pin));
+#endif
+  _delay_us(ws2812_resettime);
+  BENCH_MARK_OFF(BENCH_TRANSMIT);
+}
+
+#if defined(ws2812_parallel)
+// Setleds for four chains in parallel
+void ws2812_setleds_parallel(struct cRGB *lane0, struct cRGB *lane1,
+                             struct cRGB *lane2, struct cRGB *lane3, uint16_t leds)
+{
+  BENCH_MARK_ON(BENCH_TRANSMIT);
+  ws2812_sendarray_parallel((uint8_t*)lane0,(uint8_t*)lane1,(uint8_t*)lane2,(uint8_t*)lane3,
+                            leds+leds+leds);
+  _delay_us(ws2812_resettime);
+  BENCH_MARK_OFF(BENCH_TRANSMIT);
+}
+
+// Setleds for four chains of palette indexed LEDs in parallel
+void ws2812_setleds_palette_parallel(uint8_t *indices, uint16_t lane0, uint16_t lane1,
+                                     uint16_t lane2, uint16_t lane3, uint16_t leds,
+                                     struct cRGB *palette)
+{
+  BENCH_MARK_ON(BENCH_TRANSMIT);
+  ws2812_sendpalette_parallel(indices,lane0,lane1,lane2,lane3,leds,palette);
+  _delay_us(ws2812_resettime);
+  BENCH_MARK_OFF(BENCH_TRANSMIT);
+}
+#endif
+
+// Palette index of LED n, two LEDs per byte with the even one in the low nibble
+static inline uint8_t ws2812_index(uint8_t *indices, uint16_t n)
+{
+  uint8_t pair=indices[n>>1];
+  return (n&1) ? pair>>4 : pair&0x0f;
+}
+
 void ws2812_sendarray(uint8_t *data,uint16_t datlen)
 {
   ws2812_sendarray_mask(data,datlen,_BV(ws2812_pin));
 }
 
+// Let one pending interrupt run between two bytes if they were enabled
+// on entry. The instruction after sei is always executed first, so the
+// nop lets the interrupt in, and after its reti the cli runs before any
+// other pending one. A second handler waits for the next window instead
+// of stretching this one.
+#if defined(ws2812_irq_window)
+#define ws2812_open_window(sreg) do { \
+    if ((sreg) & _BV(SREG_I)) {       \
+      sei();                          \
+      asm volatile("nop");            \
+      cli();                          \
+    }                                 \
+  } while (0)
+
+// count the bytes sent and open a window every ws2812_irq_window of them
+#define ws2812_window_init()      uint8_t window=ws2812_irq_window
+#define ws2812_window_step(sreg) do { \
+    if (!--window) {                  \
+      ws2812_open_window(sreg);       \
+      window=ws2812_irq_window;       \
+    }                                 \
+  } while (0)
+#else
+#define ws2812_window_init()
+#define ws2812_window_step(sreg)
+#endif
+
+#if defined(ws2812_spi)
+
+/*
+  This routine writes an array of bytes with the SPI peripheral on MOSI.
+
+  At F_CPU/2 one SPI bit lasts 125 ns and every data bit is one SPI
+  byte. A '0' is sent as 11100000 (375 ns high, 625 ns low) and a '1' as
+  11111100 (750 ns high, 250 ns low). The master leaves a gap of at least
+  three cycles (190 ns) between two SPI bytes while SPDR is written, so
+  T1L is at least 440 ns and a bit at least 1.19 us, within the WS2812B
+  limits of 300 to 600 ns and 1.25 +- 0.6 us. The four bit symbols at
+  F_CPU/4 could not meet them: a '1' of 1110 has 250 ns low.
+
+  An SPI byte lasts 16 cycles, too short for an SPI_STC_vect handler to
+  feed SPDR, so the CPU encodes the next symbol while the current one
+  is shifted out and then waits for SPIF. Every symbol ends low, so
+  writing SPDR late only stretches the low time. Interrupts are handled
+  the same as by the bit-banged output: disabled while the frame is
+  sent, with a window every ws2812_irq_window bytes. The window opens
+  right after SPDR is written, so a handler runs while the hardware
+  shifts out the last bit.
+*/
+
+#if F_CPU != 16000000
+   #error "Light_ws2812: The SPI output is only timed for F_CPU = 16 MHz."
+#endif
+
+static inline void ws2812_spi_begin(void)
+{
+  DDRB |= _BV(PB2) | _BV(PB3) | _BV(PB5); // SS, MOSI, SCK
+  SPCR  = _BV(SPE) | _BV(MSTR);           // master, mode 0
+  SPSR  = _BV(SPI2X);                     // F_CPU/2
+
+  // a leading zero byte keeps the line low and sets SPIF for the loop
+  SPDR = 0;
+}
+
+static inline void ws2812_spi_end(void)
+{
+  while (!(SPSR & _BV(SPIF)));
+  SPCR = 0;
+}
+
+#define ws2812_spi_zero 0xe0
+#define ws2812_spi_one  0xfc
+
+// send one data byte as eight SPI bytes of one symbol each
+static inline void ws2812_spi_byte(uint8_t curbyte)
+{
+  uint8_t sym,i;
+
+  for (i=0; i<8; i++) {
+    sym=ws2812_spi_zero;
+    if (curbyte&0x80) sym=ws2812_spi_one;
+    curbyte<<=1;
+
+    BENCH_MARK_ON(BENCH_SPI_WAIT);
+    while (!(SPSR & _BV(SPIF)));
+    BENCH_MARK_OFF(BENCH_SPI_WAIT);
+    SPDR=sym;
+  }
+}
+
+void ws2812_sendarray_spi(uint8_t *data,uint16_t datlen)
+{
+  uint8_t sreg_prev;
+
+  sreg_prev=SREG;
+  cli();
+
+  ws2812_window_init();
+
+  ws2812_spi_begin();
+  while (datlen--) {
+    ws2812_window_step(sreg_prev);
+    ws2812_spi_byte(*data++);
+  }
+  ws2812_spi_end();
+
+  SREG=sreg_prev;
+}
+
+void ws2812_sendpalette_spi(uint8_t *indices,uint16_t leds,struct cRGB *palette)
+{
+  uint16_t n;
+  uint8_t *c;
+  uint8_t sreg_prev;
+
+  sreg_prev=SREG;
+  cli();
+
+  ws2812_window_init();
+
+  ws2812_spi_begin();
+  for (n=0; n<leds; n++) {
+    c=(uint8_t*)(palette+ws2812_index(indices,n));
+    ws2812_window_step(sreg_prev);
+    ws2812_spi_byte(c[0]);
+    ws2812_window_step(sreg_prev);
+    ws2812_spi_byte(c[1]);
+    ws2812_window_step(sreg_prev);
+    ws2812_spi_byte(c[2]);
+  }
+  ws2812_spi_end();
+
+  SREG=sreg_prev;
+}
+
+#endif
+
 /*
   This routine writes an array of bytes with RGB values to the Dataout pin
   using the fast 800kHz clockless WS2811/2812 protocol.
@@ -100,26 +288,15 @@ void ws2812_sendarray(uint8_t *data,uint16_t datlen)
 #define w_nop8  w_nop4 w_nop4
 #define w_nop16 w_nop8 w_nop8
 
-void inline ws2812_sendarray_mask(uint8_t *data,uint16_t datlen,uint8_t maskhi)
+// send one byte, MSB first
+static inline void __attribute__((always_inline)) ws2812_sendbyte(uint8_t curbyte,uint8_t maskhi,uint8_t masklo)
 {
-  uint8_t curbyte,ctr,masklo;
-  uint8_t sreg_prev;
-  
-  ws2812_DDRREG |= maskhi; // Enable output
-  
-  masklo	=~maskhi&ws2812_PORTREG;
-  maskhi |=        ws2812_PORTREG;
-  
-  sreg_prev=SREG;
-  cli();  
+  uint8_t ctr;
 
-  while (datlen--) {
-    curbyte=*data++;
-    
-    asm volatile(
-    "       ldi   %0,8  \n\t"
-    "loop%=:            \n\t"
-    "       out   %2,%3 \n\t"    //  '1' [01] '0' [01] - re
+  asm volatile(
+  "       ldi   %0,8  \n\t"
+  "loop%=:            \n\t"
+  "       out   %2,%3 \n\t"    //  '1' [01] '0' [01] - re
 #if (w1_nops&1)
 w_nop1
 #endif
@@ -135,9 +312,9 @@ w_nop8
 #if (w1_nops&16)
 w_nop16
 #endif
-    "       sbrs  %1,7  \n\t"    //  '1' [03] '0' [02]
-    "       out   %2,%4 \n\t"    //  '1' [--] '0' [03] - fe-low
-    "       lsl   %1    \n\t"    //  '1' [04] '0' [04]
+  "       sbrs  %1,7  \n\t"    //  '1' [03] '0' [02]
+  "       out   %2,%4 \n\t"    //  '1' [--] '0' [03] - fe-low
+  "       lsl   %1    \n\t"    //  '1' [04] '0' [04]
 #if (w2_nops&1)
   w_nop1
 #endif
@@ -153,7 +330,7 @@ w_nop16
 #if (w2_nops&16)
   w_nop16 
 #endif
-    "       out   %2,%4 \n\t"    //  '1' [+1] '0' [+1] - fe-high
+  "       out   %2,%4 \n\t"    //  '1' [+1] '0' [+1] - fe-high
 #if (w3_nops&1)
 w_nop1
 #endif
@@ -170,12 +347,217 @@ w_nop8
 w_nop16
 #endif
 
-    "       dec   %0    \n\t"    //  '1' [+2] '0' [+2]
-    "       brne  loop%=\n\t"    //  '1' [+3] '0' [+4]
-    :	"=&d" (ctr)
-    :	"r" (curbyte), "I" (_SFR_IO_ADDR(ws2812_PORTREG)), "r" (maskhi), "r" (masklo)
-    );
+  "       dec   %0    \n\t"    //  '1' [+2] '0' [+2]
+  "       brne  loop%=\n\t"    //  '1' [+3] '0' [+4]
+  :	"=&d" (ctr), "+r" (curbyte)
+  :	"I" (_SFR_IO_ADDR(ws2812_PORTREG)), "r" (maskhi), "r" (masklo)
+  );
+}
+
+void inline ws2812_sendarray_mask(uint8_t *data,uint16_t datlen,uint8_t maskhi)
+{
+  uint8_t masklo;
+  uint8_t sreg_prev;
+  
+  ws2812_DDRREG |= maskhi; // Enable output
+  
+  masklo	=~maskhi&ws2812_PORTREG;
+  maskhi |=        ws2812_PORTREG;
+  
+  sreg_prev=SREG;
+  cli();  
+
+  ws2812_window_init();
+
+  while (datlen--) {
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte(*data++,maskhi,masklo);
   }
   
   SREG=sreg_prev;
 }
+
+/*
+  Palette output: every LED is a four bit index into a table of colors.
+  The three bytes of the indexed color are looked up between two LEDs,
+  which only stretches the low time after the last bit of the LED before.
+*/
+void ws2812_sendpalette_mask(uint8_t *indices,uint16_t leds,struct cRGB *palette,uint8_t maskhi)
+{
+  uint8_t masklo,pair;
+  uint8_t sreg_prev;
+  uint8_t *c;
+
+  ws2812_DDRREG |= maskhi; // Enable output
+
+  masklo	=~maskhi&ws2812_PORTREG;
+  maskhi |=        ws2812_PORTREG;
+
+  sreg_prev=SREG;
+  cli();
+
+  ws2812_window_init();
+
+  while (leds) {
+    pair=*indices++;
+
+    c=(uint8_t*)(palette+(pair&0x0f));
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte(c[0],maskhi,masklo);
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte(c[1],maskhi,masklo);
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte(c[2],maskhi,masklo);
+    if (!--leds) break;
+
+    c=(uint8_t*)(palette+(pair>>4));
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte(c[0],maskhi,masklo);
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte(c[1],maskhi,masklo);
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte(c[2],maskhi,masklo);
+    leds--;
+  }
+
+  SREG=sreg_prev;
+}
+
+#if defined(ws2812_parallel)
+
+/*
+  This routine writes four byte arrays at once, one to each lane pin.
+
+  Every bit slot is 20 cycles long. The port value holding the data bits
+  of all four lanes is gathered while the previous slot is still on the
+  wire, so the eight bits of a byte are unrolled and each one tests a
+  fixed bit position. The low phase after the last bit of a byte is
+  stretched while the next four bytes are loaded.
+*/
+
+#if F_CPU != 16000000
+   #error "Light_ws2812: The parallel output is only timed for F_CPU = 16 MHz."
+#endif
+
+// gather bit n of every lane into the port value for the next slot
+#define w_par_gather(n) \
+    "       mov   %[d],%[lo]       \n\t" \
+    "       sbrc  %[b0]," #n "     \n\t" \
+    "       ori   %[d],%[m0]       \n\t" \
+    "       sbrc  %[b1]," #n "     \n\t" \
+    "       ori   %[d],%[m1]       \n\t" \
+    "       sbrc  %[b2]," #n "     \n\t" \
+    "       ori   %[d],%[m2]       \n\t" \
+    "       sbrc  %[b3]," #n "     \n\t" \
+    "       ori   %[d],%[m3]       \n\t"
+
+// send the gathered slot and gather bit n for the one after it
+#define w_par_bit(n) \
+    "       out   %[port],%[hi]    \n\t"    /* [00] re on all lanes     */ \
+    w_nop4 w_nop1                             /* [01-05]                  */ \
+    "       out   %[port],%[d]     \n\t"    /* [06] fe '0' lanes        */ \
+    "       mov   %[d],%[lo]       \n\t"    /* [07]                     */ \
+    "       sbrc  %[b0]," #n "     \n\t"    /* [08]                     */ \
+    "       ori   %[d],%[m0]       \n\t"    /* [09]                     */ \
+    "       sbrc  %[b1]," #n "     \n\t"    /* [10]                     */ \
+    "       ori   %[d],%[m1]       \n\t"    /* [11]                     */ \
+    "       sbrc  %[b2]," #n "     \n\t"    /* [12]                     */ \
+    "       ori   %[d],%[m2]       \n\t"    /* [13]                     */ \
+    "       out   %[port],%[lo]    \n\t"    /* [14] fe '1' lanes        */ \
+    "       sbrc  %[b3]," #n "     \n\t"    /* [15]                     */ \
+    "       ori   %[d],%[m3]       \n\t"    /* [16]                     */ \
+    w_nop2 w_nop1                             /* [17-19]                  */
+
+// send the last gathered slot of a byte
+#define w_par_lastbit \
+    "       out   %[port],%[hi]    \n\t"    /* [00] re on all lanes     */ \
+    w_nop4 w_nop1                             /* [01-05]                  */ \
+    "       out   %[port],%[d]     \n\t"    /* [06] fe '0' lanes        */ \
+    w_nop4 w_nop2 w_nop1                      /* [07-13]                  */ \
+    "       out   %[port],%[lo]    \n\t"    /* [14] fe '1' lanes        */
+
+// send one byte on each of the four lanes
+static inline void __attribute__((always_inline)) ws2812_sendbyte_parallel(uint8_t b0,uint8_t b1,uint8_t b2,uint8_t b3,
+                                                                           uint8_t hi,uint8_t lo)
+{
+  uint8_t d;
+
+  asm volatile(
+  w_par_gather(7)
+  w_par_bit(6)
+  w_par_bit(5)
+  w_par_bit(4)
+  w_par_bit(3)
+  w_par_bit(2)
+  w_par_bit(1)
+  w_par_bit(0)
+  w_par_lastbit
+  :  [d] "=&d" (d)
+  :  [b0] "r" (b0), [b1] "r" (b1), [b2] "r" (b2), [b3] "r" (b3),
+     [hi] "r" (hi), [lo] "r" (lo),
+     [port] "I" (_SFR_IO_ADDR(ws2812_PORTREG)),
+     [m0] "M" (_BV(ws2812_lane0_pin)), [m1] "M" (_BV(ws2812_lane1_pin)),
+     [m2] "M" (_BV(ws2812_lane2_pin)), [m3] "M" (_BV(ws2812_lane3_pin))
+  );
+}
+
+void ws2812_sendarray_parallel(uint8_t *lane0, uint8_t *lane1, uint8_t *lane2, uint8_t *lane3, uint16_t datlen)
+{
+  uint8_t hi,lo;
+  uint8_t sreg_prev;
+
+  ws2812_DDRREG |= ws2812_lanemask; // Enable outputs
+
+  lo = ~ws2812_lanemask & ws2812_PORTREG;
+  hi =  ws2812_lanemask | ws2812_PORTREG;
+
+  sreg_prev=SREG;
+  cli();
+
+  ws2812_window_init();
+
+  while (datlen--) {
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte_parallel(*lane0++,*lane1++,*lane2++,*lane3++,hi,lo);
+  }
+
+  SREG=sreg_prev;
+}
+
+// lanes are given as the index of their first LED in indices
+void ws2812_sendpalette_parallel(uint8_t *indices, uint16_t lane0, uint16_t lane1,
+                                 uint16_t lane2, uint16_t lane3, uint16_t leds,
+                                 struct cRGB *palette)
+{
+  uint8_t hi,lo;
+  uint8_t sreg_prev;
+  uint8_t *c0,*c1,*c2,*c3;
+
+  ws2812_DDRREG |= ws2812_lanemask; // Enable outputs
+
+  lo = ~ws2812_lanemask & ws2812_PORTREG;
+  hi =  ws2812_lanemask | ws2812_PORTREG;
+
+  sreg_prev=SREG;
+  cli();
+
+  ws2812_window_init();
+
+  while (leds--) {
+    c0=(uint8_t*)(palette+ws2812_index(indices,lane0++));
+    c1=(uint8_t*)(palette+ws2812_index(indices,lane1++));
+    c2=(uint8_t*)(palette+ws2812_index(indices,lane2++));
+    c3=(uint8_t*)(palette+ws2812_index(indices,lane3++));
+
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte_parallel(c0[0],c1[0],c2[0],c3[0],hi,lo);
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte_parallel(c0[1],c1[1],c2[1],c3[1],hi,lo);
+    ws2812_window_step(sreg_prev);
+    ws2812_sendbyte_parallel(c0[2],c1[2],c2[2],c3[2],hi,lo);
+  }
+
+  SREG=sreg_prev;
+}
+
+#endif
@@ -15,6 +15,7 @@
 
 #include <avr/io.h>
 #include <avr/interrupt.h>
+#include "ws2812_config.h"
 
 ///////////////////////////////////////////////////////////////////////
 // Define Reset time in µs.
@@ -69,6 +70,38 @@ void ws2812_setleds     (struct cRGB  *ledarray, uint16_t number_of_leds);
 void ws2812_setleds_pin (struct cRGB  *ledarray, uint16_t number_of_leds,uint8_t pinmask);
 void ws2812_setleds_rgbw(struct cRGBW *ledarray, uint16_t number_of_leds);
 
+/*
+ * Palette output
+ *
+ * Input:
+ *         indices:            One four bit palette index per LED, two LEDs per
+ *                             byte with the even LED in the low nibble
+ *         number_of_leds:     The number of LEDs to write
+ *         palette:            Up to 16 GRB colors the indices refer to
+ *
+ * The colors are looked up while the data is sent out, so the LED array
+ * takes a sixth of the memory of a cRGB array.
+ */
+
+void ws2812_setleds_palette(uint8_t *indices, uint16_t number_of_leds, struct cRGB *palette);
+
+/*
+ * Parallel output (ws2812_parallel in ws2812_config.h)
+ *
+ * Sends four chains of number_of_leds LEDs at the same time, one per
+ * lane pin of ws2812_port. Chains shorter than number_of_leds simply
+ * pass the surplus data out of their last LED.
+ */
+
+#if defined(ws2812_parallel)
+void ws2812_setleds_parallel(struct cRGB *lane0, struct cRGB *lane1,
+                             struct cRGB *lane2, struct cRGB *lane3, uint16_t number_of_leds);
+// lanes are given as the index of their first LED in indices
+void ws2812_setleds_palette_parallel(uint8_t *indices, uint16_t lane0, uint16_t lane1,
+                                     uint16_t lane2, uint16_t lane3, uint16_t number_of_leds,
+                                     struct cRGB *palette);
+#endif
+
 /* 
  * Old interface / Internal functions
  *
@@ -78,11 +111,26 @@ void ws2812_setleds_rgbw(struct cRGBW *ledarray, uint16_t number_of_leds);
 
 void ws2812_sendarray     (uint8_t *array,uint16_t length);
 void ws2812_sendarray_mask(uint8_t *array,uint16_t length, uint8_t pinmask);
+void ws2812_sendpalette_mask(uint8_t *indices,uint16_t leds,struct cRGB *palette,uint8_t pinmask);
+#if defined(ws2812_spi)
+void ws2812_sendarray_spi (uint8_t *array,uint16_t length);
+void ws2812_sendpalette_spi(uint8_t *indices,uint16_t leds,struct cRGB *palette);
+#endif
+#if defined(ws2812_parallel)
+void ws2812_sendarray_parallel(uint8_t *lane0, uint8_t *lane1, uint8_t *lane2, uint8_t *lane3, uint16_t length);
+void ws2812_sendpalette_parallel(uint8_t *indices, uint16_t lane0, uint16_t lane1,
+                                 uint16_t lane2, uint16_t lane3, uint16_t leds,
+                                 struct cRGB *palette);
+#endif
 
 
 /*
  * Internal defines
  */
+#if defined(ws2812_spi) && defined(ws2812_parallel)
+#error "Light_ws2812: ws2812_spi and ws2812_parallel can not be used together."
+#endif
+
 #if !defined(CONCAT)
 #define CONCAT(a, b)            a ## b
 #endif
@@ -94,4 +142,9 @@ void ws2812_sendarray_mask(uint8_t *array,uint16_t length, uint8_t pinmask);
 #define ws2812_PORTREG  CONCAT_EXP(PORT,ws2812_port)
 #define ws2812_DDRREG   CONCAT_EXP(DDR,ws2812_port)
 
+#if defined(ws2812_parallel)
+#define ws2812_lanemask (_BV(ws2812_lane0_pin) | _BV(ws2812_lane1_pin) | \
+                         _BV(ws2812_lane2_pin) | _BV(ws2812_lane3_pin))
+#endif
+
 #endif /* LIGHT_WS2812_H_ */
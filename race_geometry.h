@@ -0,0 +1,81 @@
+// Race geometry, generated by tvracec.py from race_steps.h
+// do not edit, see tvframe.h for the format
+
+// violet: 63 steps, 378 bytes as words, 195 bytes coded
+const int8_t race_deltas_violet[189] PROGMEM = {
+    1, 1, -1, 1, 1, -1, 1, 1, -1, 1, 1, -1,
+    1, 1, -1, 1, 1, -1, 1, 1, -1, 1, 1, -1,
+    1, 1, -1, 0, 1, -1, 0, 0, -1, 1, 1, -1,
+    0, 1, -1, 0, 1, -1, 0, -94, -94, 0, 0, 1,
+    0, 41, 1, 43, -1, 1, 1, -1, 1, 1, -1, 1,
+    1, -1, 1, 1, -1, 1, 1, -1, 1, 1, -1, 1,
+    1, -1, 1, 1, -1, 1, 1, -1, 1, 1, -1, 1,
+    1, -1, 1, 1, -1, 1, 1, -1, 1, 1, -1, 1,
+    1, -1, 1, 1, -1, 1, 0, -1, 1, 0, 0, 1,
+    1, 110, 112, 0, -1, 1, 0, 0, 1, 0, -1, 1,
+    1, -1, 1, 1, -1, 1, 1, -1, 1, 1, -1, 1,
+    1, -1, 1, 1, -1, 1, 1, -1, 1, 1, -1, 1,
+    1, -1, 1, 1, -1, 1, 1, -1, 1, 1, -1, 1,
+    1, -1, 1, 1, -1, 1, 1, -1, 1, 1, -1, 1,
+    1, -1, 1, 1, -1, 1, 1, -1, 1, 0, -1, 1,
+    0, 0, 1, 0, -32, -78, -89, 2, 29,
+};
+
+// beige: 39 steps, 234 bytes as words, 123 bytes coded
+const int8_t race_deltas_beige[117] PROGMEM = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
+    1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 0, 0,
+    1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0,
+    1, 0, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0,
+    1, 1, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0,
+    1, 1, 1, 1, 1, 0, 1, 0, 0, 1, 0, 0,
+    -38, -27, 0, 1, 0, 0, 1, 1, -15,
+};
+
+// yellow: 55 steps, 330 bytes as words, 171 bytes coded
+const int8_t race_deltas_yellow[165] PROGMEM = {
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 0, 1, 1, 0,
+    1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0,
+    1, 1, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0,
+    1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 0, 0,
+    1, 0, 0, 1, 0, 0, 1, 0, 0, 1, 1, 0,
+    1, 1, 0, 1, 1, 0, 1, 1, 0, 1, 1, 0,
+    1, 1, 0, 1, 1, 0, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0,
+    1, 0, 0, 1, 1, 1, 1, 1, 0, 1, 0, 0,
+    1, 0, 0, 1, 1, 0, 1, 1, 1, -53, -39, -21,
+    1, 0, 0, 1, 1, 0, 0, 0, 0,
+};
+
+// cyan: 63 steps, 378 bytes as words, 195 bytes coded
+const int8_t race_deltas_cyan[189] PROGMEM = {
+    -1, 1, -1, -1, 1, -1, -1, 1, -1, -1, 1, -1,
+    -1, 1, -1, -1, 1, -1, -1, 1, -1, -1, 1, -1,
+    -1, 1, -1, 0, 1, -1, 0, 0, -1, -1, 1, -1,
+    0, 1, -1, 0, 0, -1, 0, 3, 29, 0, 0, -66,
+    0, -66, -1, -32, 1, -1, -1, 1, -1, -1, 1, -1,
+    -1, 1, -1, -1, 1, -1, -1, 1, -1, -1, 1, -1,
+    -1, 1, -1, -1, 1, -1, -1, 1, -1, -1, 1, -1,
+    -1, 1, -1, -1, 1, -1, -1, 1, -1, -1, 1, -1,
+    -1, 1, -1, -1, 1, -1, 0, 1, -1, 0, 0, -1,
+    -41, -86, -48, 0, 0, -1, 0, 1, -1, -1, 1, -1,
+    -1, 1, -1, -1, 1, -1, -1, 1, -1, -1, 1, -1,
+    -1, 1, -1, -1, 1, -1, -1, 1, -1, -1, 1, -1,
+    -1, 1, -1, -1, 1, -1, -1, 1, -1, -1, 1, -1,
+    -1, 1, -1, -1, 1, -1, -1, 1, -1, -1, 1, -1,
+    -1, 1, -1, -1, 1, -1, -1, 1, -1, 0, 1, -1,
+    0, 0, -1, 0, 3, 49, 119, 94, 94,
+};
+
+const struct race_table race_tables[_N_RACE_TABLES] PROGMEM = {
+    {{0, 92, 120}, 63, _VIOLET, race_deltas_violet},
+    {{172, 210, 237}, 39, _BEIGE, race_deltas_beige},
+    {{255, 308, 347}, 55, _YELLOW, race_deltas_yellow},
+    {{539, 513, 512}, 63, _CYAN, race_deltas_cyan},
+};
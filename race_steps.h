@@ -0,0 +1,261 @@
+//
+// Race geometry of the TV sign
+//
+// These tables are the source of the race
+// steps but are not built into the firmware.
+// tvracec.py delta codes them into
+// race_geometry.h for the firmware, and
+// tvbench checks the decoder against them.
+// Run make race after changing them.
+//
+
+#ifndef RACE_STEPS_H_
+#define RACE_STEPS_H_
+
+#include <avr/pgmspace.h>
+
+// Number of steps in race pattern
+#define _N_RACE_STEPS 63
+#define _N_RACE_STEPS_BEIGE 39
+#define _N_RACE_STEPS_YELLOW 55
+
+// Define the LED configurations for each step
+// in the race pattern.  There is one table per
+// color with 3 entries per step, each of the 3
+// corresponding to a different LED ring.
+// generally the first corresponds to the
+// inner ring, the second to the middle ring
+// and the third to the outer ring
+const uint16_t steps_race_violet[_N_RACE_STEPS][3] PROGMEM = {
+                {0,   92,  120},
+                {1,   93,  119},
+                {2,   94,  118},
+                {3,   95,  117},
+                {4,   96,  116},
+                {5,   97,  115},
+                {6,   98,  114},
+                {7,   99,  113},
+                {8,   100, 112},
+                {9,   101, 111},
+                {9,   102, 110},
+                {9,   102, 109},
+                {10,  103, 108},
+                {10,  104, 107},
+                {10,  105, 106},
+                {10,  11,  12},
+                {10,  11,  13},
+                {10,  52,  14},
+                {53,  51,  15},
+                {54,  50,  16},
+                {55,  49,  17},
+                {56,  48,  18},
+                {57,  47,  19},
+                {58,  46,  20},
+                {59,  45,  21},
+                {60,  44,  22},
+                {61,  43,  23},
+                {62,  42,  24},
+                {63,  41,  25},
+                {64,  40,  26},
+                {65,  39,  27},
+                {66,  38,  28},
+                {67,  37,  29},
+                {68,  36,  30},
+                {69,  35,  31},
+                {69,  34,  32},
+                {69,  34,  33},
+                {70,  144, 145},
+                {70,  143, 146},
+                {70,  143, 147},
+                {70,  142, 148},
+                {71,  141, 149},
+                {72,  140, 150},
+                {73,  139, 151},
+                {74,  138, 152},
+                {75,  137, 153},
+                {76,  136, 154},
+                {77,  135, 155},
+                {78,  134, 156},
+                {79,  133, 157},
+                {80,  132, 158},
+                {81,  131, 159},
+                {82,  130, 160},
+                {83,  129, 161},
+                {84,  128, 162},
+                {85,  127, 163},
+                {86,  126, 164},
+                {87,  125, 165},
+                {88,  124, 166},
+                {89,  123, 167},
+                {89,  122, 168},
+                {89,  122, 169},
+                {89,  90,  91},
+};
+
+const uint16_t steps_race_beige[_N_RACE_STEPS_BEIGE][3] PROGMEM = {
+                {172, 210, 237},
+                {173, 211, 238},
+                {174, 212, 239},
+                {175, 213, 240},
+                {176, 214, 241},
+                {177, 215, 242},
+                {178, 216, 243},
+                {179, 217, 244},
+                {180, 218, 244},
+                {181, 219, 244},
+                {182, 220, 244},
+                {183, 221, 244},
+                {184, 221, 244},
+                {185, 221, 244},
+                {186, 221, 244},
+                {187, 221, 244},
+                {188, 221, 244},
+                {189, 221, 244},
+                {190, 222, 244},
+                {191, 223, 244},
+                {192, 224, 244},
+                {193, 225, 244},
+                {194, 226, 245},
+                {195, 227, 246},
+                {196, 228, 247},
+                {197, 229, 248},
+                {198, 230, 249},
+                {199, 231, 250},
+                {200, 232, 251},
+                {201, 233, 251},
+                {202, 233, 251},
+                {203, 233, 251},
+                {204, 234, 251},
+                {205, 235, 252},
+                {206, 236, 252},
+                {207, 236, 252},
+                {208, 236, 252},
+                {170, 209, 252},
+                {171, 209, 252},
+};
+
+const uint16_t steps_race_yellow[_N_RACE_STEPS_YELLOW][3] PROGMEM = {
+                {255, 308, 347},
+                {256, 309, 348},
+                {257, 310, 349},
+                {258, 311, 350},
+                {259, 312, 351},
+                {260, 313, 352},
+                {261, 314, 353},
+                {262, 315, 354},
+                {263, 316, 355},
+                {264, 317, 356},
+                {265, 318, 357},
+                {266, 319, 357},
+                {267, 320, 357},
+                {268, 321, 357},
+                {269, 322, 357},
+                {270, 323, 357},
+                {271, 324, 357},
+                {272, 325, 357},
+                {273, 325, 357},
+                {274, 325, 357},
+                {275, 325, 357},
+                {276, 325, 357},
+                {277, 325, 357},
+                {278, 325, 357},
+                {279, 325, 357},
+                {280, 325, 357},
+                {281, 325, 357},
+                {282, 325, 357},
+                {283, 326, 357},
+                {284, 327, 357},
+                {285, 328, 357},
+                {286, 329, 357},
+                {287, 330, 357},
+                {288, 331, 357},
+                {289, 332, 357},
+                {290, 333, 358},
+                {291, 334, 359},
+                {292, 335, 360},
+                {293, 336, 361},
+                {294, 337, 362},
+                {295, 338, 363},
+                {296, 339, 364},
+                {297, 340, 365},
+                {298, 341, 366},
+                {299, 342, 366},
+                {300, 342, 366},
+                {301, 343, 367},
+                {302, 344, 367},
+                {303, 344, 367},
+                {304, 344, 367},
+                {305, 345, 367},
+                {306, 346, 368},
+                {253, 307, 347},
+                {254, 307, 347},
+                {255, 308, 347},
+                            };
+
+const uint16_t steps_race_cyan[_N_RACE_STEPS][3] PROGMEM = {
+                {539, 513, 512},
+                {538, 514, 511},
+                {537, 515, 510},
+                {536, 516, 509},
+                {535, 517, 508},
+                {534, 518, 507},
+                {533, 519, 506},
+                {532, 520, 505},
+                {531, 521, 504},
+                {530, 522, 503},
+                {530, 523, 502},
+                {530, 523, 501},
+                {529, 524, 500},
+                {529, 525, 499},
+                {529, 525, 498},
+                {529, 528, 527},
+                {529, 528, 461},
+                {529, 462, 460},
+                {497, 463, 459},
+                {496, 464, 458},
+                {495, 465, 457},
+                {494, 466, 456},
+                {493, 467, 455},
+                {492, 468, 454},
+                {491, 469, 453},
+                {490, 470, 452},
+                {489, 471, 451},
+                {488, 472, 450},
+                {487, 473, 449},
+                {486, 474, 448},
+                {485, 475, 447},
+                {484, 476, 446},
+                {483, 477, 445},
+                {482, 478, 444},
+                {481, 479, 443},
+                {481, 480, 442},
+                {481, 480, 441},
+                {440, 394, 393},
+                {440, 394, 392},
+                {440, 395, 391},
+                {439, 396, 390},
+                {438, 397, 389},
+                {437, 398, 388},
+                {436, 399, 387},
+                {435, 400, 386},
+                {434, 401, 385},
+                {433, 402, 384},
+                {432, 403, 383},
+                {431, 404, 382},
+                {430, 405, 381},
+                {429, 406, 380},
+                {428, 407, 379},
+                {427, 408, 378},
+                {426, 409, 377},
+                {425, 410, 376},
+                {424, 411, 375},
+                {423, 412, 374},
+                {422, 413, 373},
+                {421, 414, 372},
+                {420, 415, 371},
+                {420, 416, 370},
+                {420, 416, 369},
+                {420, 419, 418},
+};
+
+#endif /* RACE_STEPS_H_ */
@@ -1,18 +1,40 @@
 """
 Send cmmands to the TV LED sign
 
-commands are sent over bluetooh
+commands are sent over bluetooh, through the
+daemon started with --daemon if it is running
 """
 
-import bluetooth
+import sys
 import time
 import argparse
 import datetime
+import json
+import os
+import struct
 import numpy as np
+import tvcodec
+import tvlink
 
 serverMACAddress = '00:20:12:08:31:18' 
 uuid = "94f39d29-7d6d-437d-973b-fba39e49d4ef"
 
+# the sign keeps 8 presets by number, their
+# names are kept on the host in this file
+N_PRESETS = 8
+PRESETS_FILE = os.path.expanduser('~/.tvsign_presets.json')
+
+# the counters record of 0x4a, 0x05, see tvstats.h
+STATS_RECORD = 26
+STATS_VERSION = 1
+STATS_FIELDS = ('ms', 'frames', 'sent', 'render', 'render_max', 'transmit',
+                'transmit_max', 'late', 'skipped', 'rx_bytes', 'rx_dropped',
+                'commands', 'latency')
+# CPU cycles per timer 0 tick, which runs at
+# F_CPU/64, and microseconds per tick at 16 MHz
+TICK_CYCLES = 64
+TICK_US = 4
+
 def parse_args():
 
     parser = argparse.ArgumentParser()
@@ -25,6 +47,22 @@ def parse_args():
     parser.add_argument('--race_length', dest='race_length', default=None, type=int, help='set race length')
     parser.add_argument('--sparkle_count', dest='sparkle_count', default=None, type=int, help='set number of sparkles')
     parser.add_argument('--toggle_auto_update', dest='toggle_auto_update', default=False, action='store_true', help='toggle auto update bit')
+    parser.add_argument('--pattern', dest='pattern', default=None, type=int, help='go to pattern (1-7, the animations from 8 on)')
+    parser.add_argument('--delay', dest='delay', default=None, type=int, help='frames each step of the pattern is shown for')
+    parser.add_argument('--set_color', dest='set_color', default=None, action='append', help='color as ID:R,G,B, may be given more than once with --batch')
+    parser.add_argument('--save_preset', dest='save_preset', default=None, help='save the settings of the sign as this preset, a number (0-7) or a name')
+    parser.add_argument('--preset', dest='preset', default=None, help='go back to this preset, a number (0-7) or a name')
+    parser.add_argument('--presets_file', dest='presets_file', default=PRESETS_FILE, help='names of the presets')
+    parser.add_argument('--batch', dest='batch', default=False, action='store_true', help='send all the given settings in one checked packet')
+    parser.add_argument('--stream', dest='stream', default=None, help='play the frames in this file, one frame per line of palette indices (0-4) per LED')
+    parser.add_argument('--stream_timeout', dest='stream_timeout', default=2.0, type=float, help='seconds to wait for a streamed frame to be shown')
+    parser.add_argument('--loop', dest='loop', default=False, action='store_true', help='repeat the streamed frames until interrupted')
+    parser.add_argument('--stats', dest='stats', default=False, action='store_true', help='poll the performance counters of the sign until interrupted')
+    parser.add_argument('--stats_interval', dest='stats_interval', default=1.0, type=float, help='seconds between two polls of the counters')
+    parser.add_argument('--daemon', dest='daemon', default=False, action='store_true', help='keep the connection open and take commands from other send_cmd.py calls')
+    parser.add_argument('--device', dest='device', default=None, help='talk to a serial device or pseudo-terminal instead of bluetooth')
+    parser.add_argument('--socket', dest='socket_path', default=tvlink.DEFAULT_SOCKET, help='unix socket of the daemon')
+    parser.add_argument('--direct', dest='direct', default=False, action='store_true', help='connect directly even if the daemon is running')
 
     return parser.parse_args()
 
@@ -36,12 +74,62 @@ def main(
     color_values=None,
     race_length=None,
     sparkle_count=None,
-    toggle_auto_update=False
+    toggle_auto_update=False,
+    pattern=None,
+    delay=None,
+    set_color=None,
+    save_preset=None,
+    preset=None,
+    presets_file=PRESETS_FILE,
+    batch=False,
+    stream=None,
+    stream_timeout=2.0,
+    loop=False,
+    stats=False,
+    stats_interval=1.0,
+    daemon=False,
+    device=None,
+    socket_path=tvlink.DEFAULT_SOCKET,
+    direct=False
 ):
-    s = get_bluetooth_service()
+    if daemon:
+        tvlink.LinkDaemon(lambda: open_sign(device)).serve(socket_path)
+        return
+
+    # presets by number, so a name that is not
+    # known can be given before connecting
+    if save_preset is not None:
+        save_preset = preset_number(presets_file, save_preset, create=True)
+    if preset is not None:
+        preset = preset_number(presets_file, preset)
 
+    s = get_link(device, socket_path, direct)
+
+    # send every setting at once
+    if batch:
+        colors = list(set_color or [])
+        if change_color is not None and color_values is not None:
+            colors.append('%d:%s' % (change_color, color_values))
+        cmds = batch_commands(
+            next_pattern=next_pattern,
+            speed=speed,
+            brightness=brightness,
+            colors=colors,
+            race_length=race_length,
+            sparkle_count=sparkle_count,
+            toggle_auto_update=toggle_auto_update,
+            pattern=pattern,
+            delay=delay,
+            save_preset=save_preset,
+            preset=preset,
+        )
+        s.send(batch_packet(cmds))
+        if s.recv(1) == bytes([1]):
+            print('applied %d commands' % len(cmds))
+        else:
+            print('batch rejected')
     #go to the next pattern
-    if next_pattern:
+    elif next_pattern:
         vals = [0x4a, 0x01]
         s.send(bytes(vals))
     #change speed
@@ -75,30 +163,266 @@ def main(
     elif sparkle_count is not None:
         send_vals = [0xa6, sparkle_count]
         s.send(bytes(send_vals))
+    # Go to a pattern
+    elif pattern is not None:
+        s.send(bytes([0xab, pattern]))
+    # Set the speed of the pattern
+    elif delay is not None:
+        s.send(bytes([0xac, delay]))
+    # Keep the settings in the sign
+    elif save_preset is not None:
+        s.send(bytes([0xad, save_preset]))
+    # Go back to kept settings
+    elif preset is not None:
+        s.send(bytes([0xae, preset]))
+    # Draw the sign from the host
+    elif stream is not None:
+        stream_frames(s, tvcodec.read_frames(stream), stream_timeout, loop)
+    # Watch what the firmware is doing
+    elif stats:
+        poll_stats(s, stats_interval, stream_timeout)
 
     print ('close connection')
     s.close()
 
-def get_bluetooth_service():
+def crc_ccitt(data, crc=0xffff):
+    """ CRC-CCITT as _crc_ccitt_update in avr-libc """
+
+    for b in data:
+        b ^= crc & 0xff
+        b ^= (b << 4) & 0xff
+        crc = ((b << 8) | (crc >> 8)) ^ (b >> 4) ^ (b << 3)
+        crc &= 0xffff
+    return crc
+
+def preset_number(path, preset, create=False):
     """
-    Connect to bluetooth 
-    and return socket
+    Number of a preset given by number or
+    name.  A new name takes the first number
+    without one if create is set
     """
 
-    service_matches = bluetooth.find_service(uuid=uuid, address=serverMACAddress)
-    
-    if len(service_matches) == 0:
-        print("Couldn't find the SampleServer service.")
-        sys.exit(0)
+    if preset.isdigit():
+        number = int(preset)
+        if number >= N_PRESETS:
+            print('presets are 0 to %d' % (N_PRESETS - 1))
+            sys.exit(1)
+        return number
+
+    names = {}
+    if os.path.exists(path):
+        with open(path) as f:
+            names = json.load(f)
+    if preset in names:
+        return names[preset]
+    if not create:
+        print('no preset named %s' % preset)
+        sys.exit(1)
+    free = sorted(set(range(N_PRESETS)) - set(names.values()))
+    if not free:
+        print('every preset has a name, see %s' % path)
+        sys.exit(1)
+    names[preset] = free[0]
+    with open(path, 'w') as f:
+        json.dump(names, f, indent=1, sort_keys=True)
+    return free[0]
+
+def batch_commands(next_pattern=False, speed=False, brightness=False,
+                   colors=(), race_length=None, sparkle_count=None,
+                   toggle_auto_update=False, pattern=None, delay=None,
+                   save_preset=None, preset=None):
+    """
+    List the commands for a batch.  The order
+    matters: a pattern change resets the delay,
+    so the delay is set after it.  A preset is
+    recalled first so the other settings change
+    it, and saved last so it holds them all
+    """
+
+    cmds = []
+    if preset is not None:
+        cmds.append([0xae, preset])
+    for color in colors:
+        index, values = color.split(':')
+        rgb = [int(x) for x in values.split(',')]
+        cmds.append([0xa4, int(index)] + rgb)
+    if race_length is not None:
+        cmds.append([0xa5, race_length])
+    if sparkle_count is not None:
+        cmds.append([0xa6, sparkle_count])
+    if toggle_auto_update:
+        cmds.append([0x4a, 0x04])
+    if next_pattern:
+        cmds.append([0x4a, 0x01])
+    if pattern is not None:
+        cmds.append([0xab, pattern])
+    if delay is not None:
+        cmds.append([0xac, delay])
+    if speed:
+        cmds.append([0x4a, 0x02])
+    if brightness:
+        cmds.append([0x4a, 0x03])
+    if save_preset is not None:
+        cmds.append([0xad, save_preset])
+
+    return cmds
+
+def batch_packet(cmds):
+    """
+    0xaa, length, the commands and the
+    CRC of length and commands
+    """
+
+    body = bytes(sum(cmds, []))
+    if len(body) > 48:
+        print('batch too long')
+        sys.exit(1)
+    crc = crc_ccitt(bytes([len(body)]) + body)
+    return bytes([0xaa, len(body)]) + body + bytes([crc >> 8, crc & 0xff])
+
+def stream_frames(s, frames, timeout, loop):
+    """
+    Play frames on the sign as fast as the
+    link allows.  Each frame is sent as the
+    shortest of its run, changed LED and raw
+    byte codings, see tvcodec.py.  A frame that is not
+    acknowledged within timeout is counted as
+    dropped and the next one is sent in full.
+    Its answer may still come, so the link is
+    drained before the next frame
+    """
+
+    if len(frames) == 0:
+        print('no frames to stream')
+        return
+
+    s.settimeout(timeout)
+    s.send(bytes([0xa7, 0x01]))
 
-    first_match = service_matches[0]
-    port = first_match["port"]
-    host = first_match["host"]
+    shown = 0
+    dropped = 0
+    late = 0
+    sent_bytes = 0
+    prev = None
+    start = time.time()
+    try:
+        while True:
+            for frame in frames:
+                data = tvcodec.frame_packets(prev, frame)
+                data += bytes([0xa7, 0x02])
+                s.send(data)
+                sent_bytes += len(data)
 
-    s = bluetooth.BluetoothSocket(bluetooth.RFCOMM)
-    s.connect((serverMACAddress, port))
+                try:
+                    s.recv(1)
+                    shown += 1
+                    prev = frame
+                except tvlink.LinkTimeout:
+                    dropped += 1
+                    prev = None
+                    late += s.drain()
+            if not loop:
+                break
+    except KeyboardInterrupt:
+        pass
 
-    return s
+    elapsed = time.time() - start
+    s.settimeout(None)
+    s.send(bytes([0xa7, 0x00]))
+
+    print('frames shown   %d' % shown)
+    print('frames dropped %d' % dropped)
+    print('late answers   %d' % late)
+    print('bytes sent     %d' % sent_bytes)
+    if elapsed > 0:
+        print('fps            %.2f' % (shown / elapsed))
+        print('bytes/s        %.0f' % (sent_bytes / elapsed))
+
+def read_stats(s):
+    """
+    Query the counters, which the sign then
+    starts over.  Returns them as a dict, see
+    tvstats.h for the fields
+    """
+
+    s.send(bytes([0x4a, 0x05]))
+    record = s.recv(STATS_RECORD)
+    if record[0] != STATS_RECORD - 1 or record[1] != STATS_VERSION:
+        raise ValueError('unknown stats record %s' % record.hex())
+    return dict(zip(STATS_FIELDS, struct.unpack('>10HBHB', record[2:])))
+
+def poll_stats(s, interval, timeout):
+    """
+    Print the counters every interval seconds
+    until interrupted.  Times are in CPU cycles,
+    to within a tick of 64 cycles
+    """
+
+    s.settimeout(timeout)
+    # the first poll covers the time since boot
+    # or since the last client asked
+    header = '%8s %6s %6s %9s %9s %9s %9s %5s %7s %7s %5s %5s %8s' % (
+        'seconds', 'fps', 'sent/s', 'render', 'max', 'transmit', 'max',
+        'late', 'skipped', 'rx B/s', 'drop', 'cmds', 'irq us')
+    lines = 0
+    try:
+        while True:
+            try:
+                c = read_stats(s)
+            except tvlink.LinkTimeout:
+                print('no answer from the sign')
+                s.drain()
+                time.sleep(interval)
+                continue
+            if lines % 20 == 0:
+                print(header)
+            lines += 1
+            seconds = c['ms'] / 1000.0 or 0.001
+            print('%8.1f %6.1f %6.1f %9d %9d %9d %9d %5d %7d %7.0f %5d %5d %8d' % (
+                seconds,
+                c['frames'] / seconds,
+                c['sent'] / seconds,
+                c['render'] * TICK_CYCLES,
+                c['render_max'] * TICK_CYCLES,
+                c['transmit'] * TICK_CYCLES,
+                c['transmit_max'] * TICK_CYCLES,
+                c['late'],
+                c['skipped'],
+                c['rx_bytes'] / seconds,
+                c['rx_dropped'],
+                c['commands'],
+                c['latency'] * TICK_US))
+            time.sleep(interval)
+    except KeyboardInterrupt:
+        pass
+    s.settimeout(None)
+
+def open_sign(device=None):
+    """
+    Connect to the sign by bluetooth, or
+    to a serial device standing in for it
+    """
+
+    if device is not None:
+        return tvlink.SerialLink(device)
+    return tvlink.BluetoothLink(serverMACAddress, uuid)
+
+def get_link(device, socket_path, direct):
+    """
+    Use the daemon if one is running,
+    otherwise connect to the sign
+    """
+
+    if not direct:
+        try:
+            return tvlink.DaemonLink(socket_path)
+        except OSError:
+            pass
+    try:
+        return open_sign(device)
+    except OSError as e:
+        print(e)
+        sys.exit(0)
 
 
 if __name__ == '__main__':
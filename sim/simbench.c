@@ -0,0 +1,310 @@
+/*
+ * Cycle-accurate pattern benchmark under simavr
+ *
+ * Loads the atmega328p firmware built with TV_BENCH_MARKERS
+ * and times the PORTC marker pins (see bench_markers.h):
+ *   PC0 high - one pass of run_frame()
+ *   PC1 high - ws2812_setleds() clocking out the frame
+ *   PC3 high - the SPI output waiting for the data register
+ * Render cycles are the PC0 high time minus the transmit
+ * time inside it.  Frames that were not sent because they
+ * had not changed are counted as elided.  The CPU time of a transmit is its length
+ * minus the SPI wait time, which is zero for the bit-banged
+ * output.
+ *
+ * The animations of anim_programs.h are measured last,
+ * after the built-in patterns they reproduce.
+ *
+ * The fade rows switch between two patterns and measure
+ * the frames of the cross-fade that follows, whose blend
+ * is part of the render.
+ *
+ * Before any pattern, fb_bench() runs each frame buffer
+ * primitive once with PC4 high, and the cycles per LED
+ * of each are printed first.
+ *
+ * Every row is checked: the render and the transmit of a
+ * frame must fit in the 20 ms frame and the row must finish
+ * in time.  The exit status is the number of rows that
+ * failed, so the run can gate a build (make sim).
+ *
+ * Patterns and their settings are selected over the UART
+ * with the same commands send_cmd.py uses, so the firmware
+ * image is the one that gets flashed apart from the markers.
+ *
+ * usage: simbench firmware.elf [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+#include "anim_programs.h"
+
+#define F_CPU 16000000
+
+// first animation pattern, see tvpatterns.c
+#define N_BUILTIN 8
+
+// give up on a scenario after this many simulated seconds
+#define SCENARIO_TIMEOUT_S 30
+
+// cycles of one frame, _FRAME_MS in tvpatterns.c
+#define FRAME_CYCLES (F_CPU / 1000 * 20)
+
+// rows that failed their check
+static int failed;
+
+static avr_t *avr;
+static avr_irq_t *uart_in;
+
+// marker state
+struct marker {
+    int high;
+    avr_cycle_count_t since;
+    avr_cycle_count_t cycles;
+    uint32_t count;
+};
+static struct marker render, transmit, spi_wait;
+
+// transmit cycles that fell inside a render pass
+static avr_cycle_count_t transmit_in_render;
+
+// the primitives fb_bench() times, in its order,
+// and the LEDs each one covers
+struct raster {
+    const char *name;
+    int leds;
+};
+static const struct raster rasters[] = {
+    {"fill", 540},
+    {"clear", 540},
+    {"sides", 540},
+    {"copy", 270},
+    {"copy+1", 269},
+    {"set loop", 540},
+    {"rgb loop", 64},
+};
+#define N_RASTER (sizeof(rasters)/sizeof(rasters[0]))
+static avr_cycle_count_t raster_cycles[N_RASTER];
+static unsigned raster_count;
+static avr_cycle_count_t raster_since;
+
+static void raster_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    if( value ) {
+        raster_since = avr->cycle;
+    }
+    else if( raster_count < N_RASTER ) {
+        raster_cycles[raster_count++] = avr->cycle - raster_since;
+    }
+}
+
+static void marker_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    struct marker *m = param;
+    if( value && !m->high ) {
+        m->high = 1;
+        m->since = avr->cycle;
+    }
+    else if( !value && m->high ) {
+        avr_cycle_count_t dt = avr->cycle - m->since;
+        m->high = 0;
+        m->cycles += dt;
+        m->count++;
+        if( m == &transmit && render.high ) {
+            transmit_in_render += dt;
+        }
+    }
+}
+
+static void reset_markers(void)
+{
+    render.cycles = render.count = 0;
+    transmit.cycles = transmit.count = 0;
+    spi_wait.cycles = spi_wait.count = 0;
+    transmit_in_render = 0;
+}
+
+// run until the given number of frames have been rendered
+static int run_frames(uint32_t frames)
+{
+    uint32_t target = render.count + frames;
+    avr_cycle_count_t limit = avr->cycle + (avr_cycle_count_t)SCENARIO_TIMEOUT_S * F_CPU;
+    while( render.count < target ) {
+        int state = avr_run(avr);
+        if( state == cpu_Done || state == cpu_Crashed ) {
+            fprintf(stderr, "simbench: firmware stopped (state %d)\n", state);
+            exit(1);
+        }
+        if( avr->cycle > limit ) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// queue a command on the UART and let the firmware act on it
+static void send_cmd(uint8_t b0, uint8_t b1)
+{
+    avr_raise_irq(uart_in, b0);
+    avr_raise_irq(uart_in, b1);
+    // two frames is enough for both bytes to arrive at 9600 baud
+    run_frames(2);
+}
+
+static void measure(const char *name, int width, int count, uint32_t frames)
+{
+    reset_markers();
+    avr_cycle_count_t start = avr->cycle;
+    int done = run_frames(frames);
+    avr_cycle_count_t elapsed = avr->cycle - start;
+
+    double passes = render.count ? render.count : 1;
+    double sent = transmit.count ? transmit.count : 1;
+    double render_cycles = (double)(render.cycles - transmit_in_render) / passes;
+    double transmit_cycles = (double)transmit.cycles / sent;
+    double busy_cycles = (double)(transmit.cycles - spi_wait.cycles) / sent;
+    double fps = elapsed ? render.count / ((double)elapsed / F_CPU) : 0;
+    double elided = render.count ? 100.0 * (render.count - transmit.count) / render.count : 0;
+
+    // an elided frame costs no transmit, so the
+    // longest frame is at most render + transmit
+    int ok = done && render_cycles + transmit_cycles <= FRAME_CYCLES;
+    failed += !ok;
+    printf("%-10s %6d %8d %8u %7.1f%% %14.0f %14.0f %14.0f %8.1f %8s%s\n",
+           name, width, count, render.count, elided,
+           render_cycles, transmit_cycles, busy_cycles, fps,
+           ok ? "ok" : "FAIL", done ? "" : "  (timeout)");
+}
+
+int main(int argc, char **argv)
+{
+    if( argc < 2 ) {
+        fprintf(stderr, "usage: %s firmware.elf [frames]\n", argv[0]);
+        return 1;
+    }
+    uint32_t frames = argc > 2 ? atoi(argv[2]) : 50;
+
+    elf_firmware_t f = {{0}};
+    if( elf_read_firmware(argv[1], &f) ) {
+        fprintf(stderr, "simbench: cannot read %s\n", argv[1]);
+        return 1;
+    }
+
+    avr = avr_make_mcu_by_name("atmega328p");
+    if( !avr ) {
+        fprintf(stderr, "simbench: atmega328p not supported by this simavr\n");
+        return 1;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &f);
+    avr->frequency = F_CPU;
+
+    // keep the UART output off stdout
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    uart_in = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 0),
+                            marker_hook, &render);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 1),
+                            marker_hook, &transmit);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 3),
+                            marker_hook, &spi_wait);
+
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 4),
+                            raster_hook, NULL);
+
+    // fb_bench() runs before the main loop starts
+    avr_cycle_count_t limit = (avr_cycle_count_t)SCENARIO_TIMEOUT_S * F_CPU;
+    while( raster_count < N_RASTER && avr->cycle < limit ) {
+        int state = avr_run(avr);
+        if( state == cpu_Done || state == cpu_Crashed ) {
+            fprintf(stderr, "simbench: firmware stopped (state %d)\n", state);
+            return 1;
+        }
+    }
+    printf("%-10s %6s %14s %14s\n", "primitive", "leds", "cycles", "cycles/led");
+    for( unsigned i = 0; i < raster_count; i++ ) {
+        printf("%-10s %6d %14llu %14.1f\n", rasters[i].name, rasters[i].leds,
+               (unsigned long long)raster_cycles[i],
+               (double)raster_cycles[i] / rasters[i].leds);
+    }
+    if( raster_count < N_RASTER ) {
+        printf("fb_bench: only %u of %u primitives seen  FAIL\n", raster_count,
+               (unsigned)N_RASTER);
+        failed++;
+    }
+    printf("\n");
+
+    printf("%-10s %6s %8s %8s %8s %14s %14s %14s %8s %8s\n",
+           "pattern", "width", "sparkle", "frames", "elided",
+           "cycles/render", "cycles/xmit", "xmit cpu", "fps", "check");
+
+    // the turn-on pattern only changes for 14 frames before it holds
+    measure("turnon", 0, 0, 14);
+
+    // stay on each pattern until told to move on
+    send_cmd(0x4a, 0x04);
+    // the turn-on pattern hands over to wave by itself,
+    // and sends nothing until then
+    uint32_t sent = transmit.count;
+    while( transmit.count == sent && run_frames(1) ) {
+    }
+
+    measure("wave", 0, 0, frames);
+    send_cmd(0x4a, 0x01);
+    measure("switch", 0, 0, frames);
+    send_cmd(0x4a, 0x01);
+    measure("breathe", 0, 0, frames);
+    send_cmd(0x4a, 0x01);
+
+    // the race moves a step every frame, so the
+    // cycles per render are the cycles per step
+    static const int widths[] = {1, 10, 20, 30, 40, 50, 60};
+    for( int rev = 0; rev < 2; rev++ ) {
+        send_cmd(0xac, 1);
+        for( unsigned i = 0; i < sizeof(widths)/sizeof(widths[0]); i++ ) {
+            send_cmd(0xa5, widths[i]);
+            measure(rev ? "race_rev" : "race", widths[i], 0, frames);
+        }
+        send_cmd(0x4a, 0x01);
+    }
+
+    static const int counts[] = {1, 8, 20};
+    for( unsigned i = 0; i < sizeof(counts)/sizeof(counts[0]); i++ ) {
+        send_cmd(0xa6, counts[i]);
+        measure("sparkle", 0, counts[i], frames);
+    }
+
+    // the interpreted versions of wave, switch and
+    // race run the same frames as the C patterns
+    static const char *anims[_N_ANIM] = {_ANIM_NAMES};
+    for( int i = 0; i < _N_ANIM; i++ ) {
+        char name[16];
+        snprintf(name, sizeof(name), "a:%s", anims[i]);
+        send_cmd(0xab, N_BUILTIN + i);
+        measure(name, 0, 0, frames);
+    }
+
+    // a fade lasts 16 frames, two of which
+    // pass while the command arrives
+    static const int fades[][2] = {{1, 4}, {4, 2}, {2, 6}, {6, 3}};
+    for( unsigned i = 0; i < sizeof(fades)/sizeof(fades[0]); i++ ) {
+        char name[16];
+        snprintf(name, sizeof(name), "fade %d>%d", fades[i][0], fades[i][1]);
+        send_cmd(0xab, fades[i][0]);
+        run_frames(40);
+        send_cmd(0xab, fades[i][1]);
+        measure(name, 0, 0, 13);
+    }
+
+    return failed;
+}
@@ -0,0 +1,276 @@
+/*
+ * Sound pattern check under simavr
+ *
+ * Selects the sound pattern over the UART and feeds the
+ * microphone input (ADC5) one sample per conversion,
+ * either from a recorded stream or from a built-in test
+ * signal, a 1200 Hz tone with a 150 Hz kick twice a
+ * second.  A recorded stream is raw unsigned 8 bit
+ * samples at the ADC rate (9615 Hz), for example
+ *
+ *   sox song.wav -r 9615 -c 1 -b 8 -e unsigned song.raw
+ *
+ * It reports the windows analysed, the cycles of each
+ * analysis (PB1 high in sound_window, PB5 with the
+ * parallel output, see bench_markers.h) and the cycles
+ * per render of the pattern, which include the analysis.
+ * The stream loops if it is shorter than the run.
+ *
+ * The run fails (exit status 1) unless every window of
+ * samples is analysed and the render plus the longest
+ * transmit fit the 20 ms frame.
+ *
+ * The firmware must be built with TV_BENCH_MARKERS, and
+ * this harness with the same BENCH_CFLAGS.
+ *
+ * usage: simsound firmware.elf [samples.raw] [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <math.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+#include <simavr/avr_adc.h>
+
+#define F_CPU 16000000
+#define SAMPLE_RATE (F_CPU / 128 / 13)
+// millivolts of the reference, AVcc
+#define AVCC_MV 5000
+
+// the sound pattern, _SOUND_PATTERN in
+// tvpatterns.c
+#define PAT_SOUND 7
+
+// samples per window, _SOUND_WINDOW in tvsound.h
+#define SOUND_WINDOW 64
+
+// cycles of one frame, _FRAME_MS in tvpatterns.c
+#define FRAME_CYCLES (F_CPU / 1000 * 20)
+
+// PORTB pin of the window marker, BENCH_SOUND
+#if defined(ws2812_parallel)
+#define SOUND_PIN 5
+#else
+#define SOUND_PIN 1
+#endif
+
+// give up after this many simulated seconds
+#define TIMEOUT_S 60
+
+static avr_t *avr;
+static avr_irq_t *uart_in;
+static avr_irq_t *adc_in;
+
+// samples of the stream and the next one to convert
+static uint8_t *samples;
+static long n_samples;
+static long next_sample;
+static long converted;
+
+// analysis windows and render passes
+static int measuring;
+static avr_cycle_count_t window_since, render_since;
+static avr_cycle_count_t window_cycles, window_min, window_max;
+static uint32_t windows;
+static avr_cycle_count_t render_cycles;
+static uint32_t renders;
+static avr_cycle_count_t transmit_since, transmit_max;
+
+// put the next sample on the input as the
+// ADC starts to convert it
+static void adc_trigger_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    uint8_t s = samples[next_sample];
+    if( ++next_sample == n_samples ) {
+        next_sample = 0;
+    }
+    converted++;
+    avr_raise_irq(adc_in, (uint32_t)s * AVCC_MV / 256);
+}
+
+static void window_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    if( value ) {
+        window_since = avr->cycle;
+    }
+    else if( measuring ) {
+        avr_cycle_count_t dt = avr->cycle - window_since;
+        window_cycles += dt;
+        if( windows == 0 || dt < window_min ) {
+            window_min = dt;
+        }
+        if( dt > window_max ) {
+            window_max = dt;
+        }
+        windows++;
+    }
+}
+
+static void render_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    if( value ) {
+        render_since = avr->cycle;
+    }
+    else {
+        if( measuring ) {
+            render_cycles += avr->cycle - render_since;
+        }
+        renders++;
+    }
+}
+
+static void transmit_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    if( value ) {
+        transmit_since = avr->cycle;
+    }
+    else if( measuring && avr->cycle - transmit_since > transmit_max ) {
+        transmit_max = avr->cycle - transmit_since;
+    }
+}
+
+// run until the given number of frames have been rendered
+static int run_frames(uint32_t frames)
+{
+    uint32_t target = renders + frames;
+    avr_cycle_count_t limit = avr->cycle + (avr_cycle_count_t)TIMEOUT_S * F_CPU;
+    while( renders < target ) {
+        int state = avr_run(avr);
+        if( state == cpu_Done || state == cpu_Crashed ) {
+            fprintf(stderr, "simsound: firmware stopped (state %d)\n", state);
+            exit(1);
+        }
+        if( avr->cycle > limit ) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+static void send_cmd(uint8_t b0, uint8_t b1)
+{
+    avr_raise_irq(uart_in, b0);
+    avr_raise_irq(uart_in, b1);
+    run_frames(2);
+}
+
+// the built-in test signal, ten seconds of it
+static long test_signal(uint8_t **out)
+{
+    long n = 10L * SAMPLE_RATE;
+    uint8_t *s = malloc(n);
+    for( long i = 0; i < n; i++ ) {
+        long age = i % (SAMPLE_RATE / 2);
+        double x = 60 * sin(2 * M_PI * 1200 * i / SAMPLE_RATE) +
+                   100 * exp(-age / 400.0) * sin(2 * M_PI * 150 * age / SAMPLE_RATE);
+        int v = 128 + (int)x;
+        s[i] = v < 0 ? 0 : v > 255 ? 255 : v;
+    }
+    *out = s;
+    return n;
+}
+
+static long read_samples(const char *path, uint8_t **out)
+{
+    FILE *f = fopen(path, "rb");
+    if( !f ) {
+        return 0;
+    }
+    fseek(f, 0, SEEK_END);
+    long n = ftell(f);
+    fseek(f, 0, SEEK_SET);
+    uint8_t *s = malloc(n > 0 ? n : 1);
+    n = fread(s, 1, n, f);
+    fclose(f);
+    *out = s;
+    return n;
+}
+
+int main(int argc, char **argv)
+{
+    if( argc < 2 ) {
+        fprintf(stderr, "usage: %s firmware.elf [samples.raw] [frames]\n", argv[0]);
+        return 1;
+    }
+    uint32_t frames = argc > 3 ? atoi(argv[3]) : 250;
+
+    if( argc > 2 ) {
+        n_samples = read_samples(argv[2], &samples);
+        if( n_samples <= 0 ) {
+            fprintf(stderr, "simsound: cannot read samples from %s\n", argv[2]);
+            return 1;
+        }
+    }
+    else {
+        n_samples = test_signal(&samples);
+    }
+
+    elf_firmware_t f = {{0}};
+    if( elf_read_firmware(argv[1], &f) ) {
+        fprintf(stderr, "simsound: cannot read %s\n", argv[1]);
+        return 1;
+    }
+    avr = avr_make_mcu_by_name("atmega328p");
+    if( !avr ) {
+        fprintf(stderr, "simsound: atmega328p not supported by this simavr\n");
+        return 1;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &f);
+    avr->frequency = F_CPU;
+    avr->vcc = AVCC_MV;
+    avr->avcc = AVCC_MV;
+
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    uart_in = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+
+    adc_in = avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_ADC5);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_ADC_GETIRQ, ADC_IRQ_OUT_TRIGGER),
+                            adc_trigger_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 0),
+                            render_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 1),
+                            transmit_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), SOUND_PIN),
+                            window_hook, NULL);
+
+    // stay on the sound pattern
+    run_frames(1);
+    send_cmd(0x4a, 0x04);
+    send_cmd(0xab, PAT_SOUND);
+
+    measuring = 1;
+    renders = 0;
+    long start_converted = converted;
+    avr_cycle_count_t start = avr->cycle;
+    int done = run_frames(frames);
+    double seconds = (double)(avr->cycle - start) / F_CPU;
+    measuring = 0;
+
+    // each full window is analysed by the next
+    // frame, so at most the last two are pending
+    long full = (converted - start_converted) / SOUND_WINDOW;
+    double render = renders ? (double)render_cycles / renders : 0;
+    int ok = done && windows > 0 && windows + 2 >= full &&
+             render + transmit_max <= FRAME_CYCLES;
+
+    printf("%-10s %8s %10s %8s %14s %14s %14s %14s %14s %8s\n", "samples", "frames",
+           "windows", "win/s", "cycles/window", "min", "max", "cycles/render",
+           "xmit max", "check");
+    printf("%-10ld %8u %10u %8.1f %14.0f %14llu %14llu %14.0f %14llu %8s%s\n",
+           converted - start_converted, renders, windows,
+           seconds > 0 ? windows / seconds : 0,
+           windows ? (double)window_cycles / windows : 0,
+           (unsigned long long)window_min, (unsigned long long)window_max,
+           render, (unsigned long long)transmit_max,
+           ok ? "ok" : "FAIL", done ? "" : "  (timeout)");
+    return ok ? 0 : 1;
+}
@@ -0,0 +1,340 @@
+/*
+ * Bluetooth command streaming check under simavr
+ *
+ * Streams 0xa4 color commands (5 bytes each, sent back to
+ * back at the line rate) into the firmware while a pattern
+ * keeps the LED output busy.  A third of the way through
+ * the pattern button is pressed, half way a 0x4a, 0x05
+ * stats query goes out, and at two thirds the sound
+ * pattern is selected, so every interrupt handler of the
+ * firmware runs during a frame.  It checks that nothing is
+ * lost:
+ *
+ *  - every byte must reach the USART receive interrupt (PC2
+ *    marker, see bench_markers.h) within two byte times of
+ *    arriving. The USART holds two received bytes, so a later
+ *    read would overrun on the real part.
+ *  - every command must be acknowledged and the stats
+ *    record must come back whole, so none was split or
+ *    dropped by the command handling.
+ *  - every interrupt handler must return within
+ *    MAX_ISR_CYCLES, the budget of an interrupt window in
+ *    ws2812_config.h, and must have run at least once.
+ *  - at most one handler may run in a low time of the data
+ *    line, a second pending one waits for the next window.
+ *  - while a frame is sent (PC1 marker) the data line must
+ *    never stay low for longer than MAX_LOW_GAP before its
+ *    next bit, or the LEDs would latch in the middle of the
+ *    frame.
+ *
+ * The firmware must be built with TV_BENCH_MARKERS, and
+ * this harness with the same BENCH_CFLAGS.
+ *
+ * usage: simuart firmware.elf [commands]
+ * exits with 1 if any byte or command was lost
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <simavr/sim_avr.h>
+#include <simavr/sim_elf.h>
+#include <simavr/sim_io.h>
+#include <simavr/avr_ioport.h>
+#include <simavr/avr_uart.h>
+
+#define F_CPU 16000000
+#define BAUD 9615
+// 10 bits per byte: start, 8 data, stop
+#define BYTE_CYCLES ((avr_cycle_count_t)F_CPU * 10 / BAUD)
+#define MAX_LATENCY (2 * BYTE_CYCLES)
+
+#define MAX_BYTES 4096
+
+// handler budget of an interrupt window, and the
+// longest low time of the data line within a frame:
+// the budget plus the low time of a bit
+#define MAX_ISR_CYCLES 80
+#define MAX_LOW_GAP ((avr_cycle_count_t)F_CPU * 6 / 1000000)
+
+// atmega328p interrupt vectors
+#define VECTOR_INT0 1
+#define VECTOR_INT1 2
+#define VECTOR_PCINT2 5
+#define VECTOR_TIMER1_OVF 13
+#define VECTOR_TIMER0_COMPA 14
+#define VECTOR_USART_RX 18
+#define VECTOR_USART_UDRE 19
+#define VECTOR_ADC 21
+
+// the sound pattern, _SOUND_PATTERN in tvpatterns.c
+#define PAT_SOUND 7
+
+// bytes of the stats record, _STATS_RECORD in tvstats.h
+#define STATS_RECORD 26
+
+// commands the pattern button (PD2) is held down for,
+// longer than the debounce time of timer 1
+#define BUTTON_COMMANDS 10
+
+// the LED data line, ws2812_pin or MOSI for the SPI output
+#if defined(ws2812_spi)
+#define DATA_PIN 3
+#else
+#define DATA_PIN 2
+#endif
+
+static avr_t *avr;
+
+// arrival time of every byte sent, and how many the
+// receive interrupt has taken so far
+static avr_cycle_count_t sent_at[MAX_BYTES];
+static int n_sent, n_taken;
+static avr_cycle_count_t worst_latency;
+static int late;
+
+static int acks;
+
+// cycles of each run of an interrupt handler, by vector,
+// and how many of the runs were during a frame
+struct isr_time {
+    const char *name;
+    uint8_t vector;
+    avr_cycle_count_t since, worst;
+    uint32_t runs, in_frame;
+};
+static struct isr_time isrs[] = {
+    { "USART_RX", VECTOR_USART_RX },
+    { "USART_UDRE", VECTOR_USART_UDRE },
+    { "TIMER0_COMPA", VECTOR_TIMER0_COMPA },
+    { "TIMER1_OVF", VECTOR_TIMER1_OVF },
+    { "INT0", VECTOR_INT0 },
+    { "ADC", VECTOR_ADC },
+};
+#define N_ISRS (sizeof(isrs)/sizeof(isrs[0]))
+
+// the speed and brightness buttons are not pressed,
+// their handlers are only timed if they run
+static struct isr_time idle_isrs[] = {
+    { "INT1", VECTOR_INT1 },
+    { "PCINT2", VECTOR_PCINT2 },
+};
+#define N_IDLE_ISRS (sizeof(idle_isrs)/sizeof(idle_isrs[0]))
+
+// low times of the data line while a frame is sent, and
+// the handlers that ran in them
+static int transmitting;
+static avr_cycle_count_t transmit_since, data_fell;
+static avr_cycle_count_t worst_gap;
+static uint32_t frames;
+static int gap_isrs, worst_gap_isrs;
+
+static void uart_isr_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    if( !value || n_taken >= n_sent ) {
+        return;
+    }
+    avr_cycle_count_t latency = avr->cycle - sent_at[n_taken++];
+    if( latency > worst_latency ) {
+        worst_latency = latency;
+    }
+    if( latency > MAX_LATENCY ) {
+        late++;
+    }
+}
+
+static void uart_out_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    acks++;
+}
+
+static void isr_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    struct isr_time *t = param;
+    if( value ) {
+        t->since = avr->cycle;
+        if( transmitting ) {
+            t->in_frame++;
+            if( ++gap_isrs > worst_gap_isrs ) {
+                worst_gap_isrs = gap_isrs;
+            }
+        }
+        return;
+    }
+    if( avr->cycle - t->since > t->worst ) {
+        t->worst = avr->cycle - t->since;
+    }
+    t->runs++;
+}
+
+static void transmit_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    transmitting = value != 0;
+    gap_isrs = 0;
+    if( transmitting ) {
+        transmit_since = avr->cycle;
+        frames++;
+    }
+}
+
+// a low time only counts if the line goes high again
+// within the frame, the reset time at its end does not
+static void data_hook(struct avr_irq_t *irq, uint32_t value, void *param)
+{
+    if( !value ) {
+        data_fell = avr->cycle;
+        return;
+    }
+    gap_isrs = 0;
+    if( transmitting && data_fell >= transmit_since &&
+        avr->cycle - data_fell > worst_gap ) {
+        worst_gap = avr->cycle - data_fell;
+    }
+}
+
+// the bytes to stream, the 0xa4 commands with the stats
+// query and the switch to the sound pattern among them
+static uint8_t script[MAX_BYTES];
+static int n_script;
+
+static void script_add(uint8_t b)
+{
+    script[n_script++] = b;
+}
+
+static int isr_check(struct isr_time *t, int must_run)
+{
+    printf("%-18s %llu cycles worst of %u, %u in frames (limit %d)\n", t->name,
+           (unsigned long long)t->worst, t->runs, t->in_frame, MAX_ISR_CYCLES);
+    return (t->runs > 0 || !must_run) && t->worst <= MAX_ISR_CYCLES;
+}
+
+int main(int argc, char **argv)
+{
+    if( argc < 2 ) {
+        fprintf(stderr, "usage: %s firmware.elf [commands]\n", argv[0]);
+        return 1;
+    }
+    int commands = argc > 2 ? atoi(argv[2]) : 200;
+    if( commands * 5 + 4 > MAX_BYTES ) {
+        commands = (MAX_BYTES - 4) / 5;
+    }
+    if( commands < 3 * BUTTON_COMMANDS ) {
+        commands = 3 * BUTTON_COMMANDS;
+    }
+    for( int i = 0; i < commands; i++ ) {
+        if( i == commands / 2 ) {
+            script_add(0x4a);
+            script_add(0x05);
+        }
+        if( i == commands * 2 / 3 ) {
+            script_add(0xab);
+            script_add(PAT_SOUND);
+        }
+        script_add(0xa4);
+        script_add((i & 3) + 1);
+        script_add(8);
+        script_add(3);
+        script_add(1);
+    }
+
+    elf_firmware_t f = {{0}};
+    if( elf_read_firmware(argv[1], &f) ) {
+        fprintf(stderr, "simuart: cannot read %s\n", argv[1]);
+        return 1;
+    }
+    avr = avr_make_mcu_by_name("atmega328p");
+    if( !avr ) {
+        fprintf(stderr, "simuart: atmega328p not supported by this simavr\n");
+        return 1;
+    }
+    avr_init(avr);
+    avr_load_firmware(avr, &f);
+    avr->frequency = F_CPU;
+
+    uint32_t flags = 0;
+    avr_ioctl(avr, AVR_IOCTL_UART_GET_FLAGS('0'), &flags);
+    flags &= ~AVR_UART_FLAG_STDIO;
+    avr_ioctl(avr, AVR_IOCTL_UART_SET_FLAGS('0'), &flags);
+    avr_irq_t *uart_in = avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_INPUT);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_UART_GETIRQ('0'), UART_IRQ_OUTPUT),
+                            uart_out_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 2),
+                            uart_isr_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('C'), 1),
+                            transmit_hook, NULL);
+    avr_irq_register_notify(avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('B'), DATA_PIN),
+                            data_hook, NULL);
+    for( unsigned i = 0; i < N_ISRS; i++ ) {
+        avr_irq_register_notify(avr_get_interrupt_irq(avr, isrs[i].vector) +
+                                AVR_INT_IRQ_RUNNING, isr_hook, &isrs[i]);
+    }
+    for( unsigned i = 0; i < N_IDLE_ISRS; i++ ) {
+        avr_irq_register_notify(avr_get_interrupt_irq(avr, idle_isrs[i].vector) +
+                                AVR_INT_IRQ_RUNNING, isr_hook, &idle_isrs[i]);
+    }
+    // the buttons pull their pins low, the firmware
+    // enables the pull ups
+    avr_irq_t *button = avr_io_getirq(avr, AVR_IOCTL_IOPORT_GETIRQ('D'), 2);
+    avr_raise_irq(button, 1);
+
+    // let the turn-on pattern hand over to wave,
+    // which sends a full frame every frame period
+    avr_cycle_count_t start = avr->cycle + (avr_cycle_count_t)F_CPU * 3;
+    while( avr->cycle < start ) {
+        avr_run(avr);
+    }
+
+    // one byte per byte time, as the bluetooth module would send
+    // them, with the pattern button held down for a while
+    int total = n_script;
+    int press = total / 3;
+    int release = press + BUTTON_COMMANDS * 5;
+    avr_cycle_count_t next = avr->cycle;
+    while( n_sent < total ) {
+        int state = avr_run(avr);
+        if( state == cpu_Done || state == cpu_Crashed ) {
+            fprintf(stderr, "simuart: firmware stopped (state %d)\n", state);
+            return 1;
+        }
+        if( avr->cycle >= next ) {
+            if( n_sent == press || n_sent == release ) {
+                avr_raise_irq(button, n_sent == release);
+            }
+            sent_at[n_sent] = avr->cycle;
+            avr_raise_irq(uart_in, script[n_sent]);
+            n_sent++;
+            next += BYTE_CYCLES;
+        }
+    }
+
+    // give the last command time to be handled, and the
+    // button time to be taken on the timer 1 overflow,
+    // up to 65536 * 64 cycles after the press
+    avr_cycle_count_t end = avr->cycle + (avr_cycle_count_t)F_CPU * 3 / 10;
+    while( avr->cycle < end ) {
+        avr_run(avr);
+    }
+
+    printf("commands sent      %d\n", commands);
+    printf("bytes answered     %d of %d\n", acks, commands + STATS_RECORD);
+    printf("bytes received     %d of %d\n", n_taken, total);
+    printf("worst latency      %llu cycles (limit %llu)\n",
+           (unsigned long long)worst_latency, (unsigned long long)MAX_LATENCY);
+    printf("late bytes         %d\n", late);
+    int isr_ok = 1;
+    for( unsigned i = 0; i < N_ISRS; i++ ) {
+        isr_ok &= isr_check(&isrs[i], 1);
+    }
+    for( unsigned i = 0; i < N_IDLE_ISRS; i++ ) {
+        isr_ok &= isr_check(&idle_isrs[i], 0);
+    }
+    printf("longest low time   %llu cycles in %u frames (limit %llu)\n",
+           (unsigned long long)worst_gap, frames, (unsigned long long)MAX_LOW_GAP);
+    printf("handlers per gap   %d at most (limit 1)\n", worst_gap_isrs);
+
+    int ok = acks == commands + STATS_RECORD && n_taken == total && late == 0 &&
+             isr_ok && frames > 0 && worst_gap <= MAX_LOW_GAP && worst_gap_isrs <= 1;
+    printf("%s\n", ok ? "PASS" : "FAIL");
+    return ok ? 0 : 1;
+}
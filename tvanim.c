@@ -0,0 +1,144 @@
+//
+// Animation interpreter for the TV sign
+//
+// Runs one frame of the current animation per
+// call.  The program counter, the hold and the
+// repeat loops are the whole state, so switching
+// animations only resets them.
+//
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#define ANIM_PROGRAMS
+#include "tvframe.h"
+#include "tvanim.h"
+
+struct anim_loop {
+    uint16_t pc;
+    uint8_t count;
+};
+
+static const uint8_t *prog;
+static uint16_t pc;
+// frames left to hold the current frame
+static uint16_t hold;
+static uint8_t depth;
+static struct anim_loop loops[_ANIM_DEPTH];
+
+static const uint8_t *program(uint8_t index)
+{
+    return (const uint8_t *)pgm_read_ptr(&anim_programs[index]);
+}
+
+// start an animation from its first instruction
+void anim_start(uint8_t index)
+{
+    prog = program(index);
+    pc = _ANIM_HEADER;
+    hold = 0;
+    depth = 0;
+}
+
+// a delay limit from the program header
+uint8_t anim_delay(uint8_t index, uint8_t field)
+{
+    return pgm_read_byte(program(index) + field);
+}
+
+// passes through the program before
+// the next pattern
+uint16_t anim_passes(uint8_t index)
+{
+    const uint8_t *p = program(index) + _ANIM_PASSES;
+    return (pgm_read_byte(p) << 8) | pgm_read_byte(p + 1);
+}
+
+static uint8_t fetch()
+{
+    return pgm_read_byte(prog + pc++);
+}
+
+static uint16_t fetch_word()
+{
+    uint16_t w = fetch() << 8;
+    return w | fetch();
+}
+
+// Run the animation until it holds a frame.  A
+// step of a hold is delay frames.  The program
+// starts over at its end, but only once per
+// frame in case it never holds.  Returns 1 if
+// the end was reached
+uint8_t anim_frame(uint8_t delay)
+{
+    if( hold > 1 ) {
+        hold--;
+        return 0;
+    }
+    hold = 0;
+
+    uint8_t wrapped = 0;
+    for( uint8_t ops = 0; ops < _ANIM_MAX_OPS; ops++ ) {
+        uint8_t op = fetch();
+        if( op == _ANIM_END ) {
+            if( wrapped ) {
+                pc--;
+                break;
+            }
+            pc = _ANIM_HEADER;
+            depth = 0;
+            wrapped = 1;
+        }
+        else if( op == _ANIM_CLEAR ) {
+            fb_clear();
+        }
+        else if( op == _ANIM_FILL ) {
+            uint16_t start = fetch_word();
+            uint16_t end = fetch_word();
+            fb_fill(start, end, fetch());
+        }
+        else if( op == _ANIM_RING ) {
+            fb_ring(fetch());
+        }
+        else if( op == _ANIM_COLOR ) {
+            uint8_t c = fetch();
+            palette[c][0] = fetch();
+            palette[c][1] = fetch();
+            palette[c][2] = fetch();
+            fb_palette_changed();
+        }
+        else if( op == _ANIM_SHOW ) {
+            show_leds(fetch());
+        }
+        else if( op == _ANIM_WAIT ) {
+            hold = fetch() * delay;
+            if( hold ) {
+                break;
+            }
+        }
+        else if( op == _ANIM_LOOP ) {
+            loops[depth].count = fetch();
+            loops[depth].pc = pc;
+            depth++;
+        }
+        else if( op == _ANIM_NEXT ) {
+            struct anim_loop *l = &loops[depth - 1];
+            if( --l->count ) {
+                pc = l->pc;
+            }
+            else {
+                depth--;
+            }
+        }
+        else if( op == _ANIM_RACE ) {
+            uint8_t width = fetch();
+            anim_race(width, fetch());
+        }
+        else if( op == _ANIM_COPY ) {
+            uint16_t dst = fetch_word();
+            uint16_t src = fetch_word();
+            fb_copy(dst, src, fetch_word());
+        }
+    }
+    return wrapped;
+}
@@ -0,0 +1,77 @@
+//
+// Animation programs for the TV sign
+//
+// An animation is a byte code program in flash
+// which draws into the frame buffer.  It is
+// compiled from a text description by
+// tvanimc.py into anim_programs.h.
+//
+// A program starts with a header
+//
+//   nominal delay, minimum delay, maximum delay,
+//   passes high, passes low
+//
+// with the frames per step limits as for the
+// built-in patterns and the number of passes
+// through the program before the sign moves on
+// to the next pattern.  The code follows, words
+// are high byte first:
+//
+//   0x00                   end, start over at the next frame
+//   0x01                   clear the frame
+//   0x02 s(2) e(2) c       fill LEDs s to e-1 with color c
+//   0x03 r                 light ring r, see fb_ring
+//   0x04 c r g b           set palette entry c
+//   0x05 level             send the frame at level
+//   0x06 n                 hold the frame for n steps
+//   0x07 n                 repeat up to the matching
+//                          next n times, 0 is 256
+//   0x08                   next
+//   0x09 width direction   move the race trains one step
+//                          and draw them, width 0 uses
+//                          the race width setting
+//   0x0a d(2) s(2) n(2)    copy n LEDs from s on to d
+//
+
+#ifndef TVANIM_H_
+#define TVANIM_H_
+
+#include <avr/io.h>
+#include "anim_programs.h"
+
+#define _ANIM_END 0x00
+#define _ANIM_CLEAR 0x01
+#define _ANIM_FILL 0x02
+#define _ANIM_RING 0x03
+#define _ANIM_COLOR 0x04
+#define _ANIM_SHOW 0x05
+#define _ANIM_WAIT 0x06
+#define _ANIM_LOOP 0x07
+#define _ANIM_NEXT 0x08
+#define _ANIM_RACE 0x09
+#define _ANIM_COPY 0x0a
+
+// header fields
+#define _ANIM_NOM_DELAY 0
+#define _ANIM_MIN_DELAY 1
+#define _ANIM_MAX_DELAY 2
+#define _ANIM_PASSES 3
+#define _ANIM_HEADER 5
+
+// nesting of repeat loops
+#define _ANIM_DEPTH 4
+
+// instructions run in one frame at most, so
+// a program without holds cannot stall the
+// main loop
+#define _ANIM_MAX_OPS 255
+
+void anim_start(uint8_t index);
+uint8_t anim_frame(uint8_t delay);
+uint8_t anim_delay(uint8_t index, uint8_t field);
+uint16_t anim_passes(uint8_t index);
+
+// race steps are drawn by the patterns
+void anim_race(uint8_t width, uint8_t direction);
+
+#endif /* TVANIM_H_ */
@@ -0,0 +1,247 @@
+"""
+Compile animations for the TV sign
+
+Each .anim file describes one animation, which
+becomes a pattern after the built-in ones.  The
+byte code is described in tvanim.h.  One statement
+per line, # starts a comment:
+
+  delay nominal min max   frames per step of a hold
+  passes n                passes before the next pattern
+  clear                   all LEDs off
+  fill side color         light a whole side, e.g. fill violet cyan
+  fill start end color    light LEDs start to end-1
+  ring r                  light ring r (0-2) in the side colors
+  color c r g b           change palette entry c
+  show [level]            send the frame (level 4 if not given)
+  wait [n]                hold the frame for n steps (default 1)
+  repeat n ... next       run the statements between n times
+  race [width] [reverse]  move the race trains one step and
+                          draw them, the width defaults to
+                          the race width setting
+  copy start end to       copy LEDs start to end-1 so that
+                          they start at LED to
+
+Colors are off, violet, beige, yellow and cyan.
+The program starts over after its last statement.
+
+usage: tvanimc.py [-o anim_programs.h] file.anim...
+"""
+
+import os
+import sys
+
+N_LEDS = 540
+
+COLORS = {'off': 0, 'violet': 1, 'beige': 2, 'yellow': 3, 'cyan': 4}
+
+# LED ranges of the sides, see tvframe.h
+SIDES = {
+    'violet': (0, 170),
+    'beige': (170, 253),
+    'yellow': (253, 369),
+    'cyan': (369, N_LEDS),
+}
+
+N_RINGS = 3
+MAX_LEVEL = 4
+MAX_DEPTH = 4
+
+END = 0x00
+CLEAR = 0x01
+FILL = 0x02
+RING = 0x03
+COLOR = 0x04
+SHOW = 0x05
+WAIT = 0x06
+LOOP = 0x07
+NEXT = 0x08
+RACE = 0x09
+COPY = 0x0a
+
+class CompileError(Exception):
+    pass
+
+def number(word, low, high):
+    """ an integer within low and high """
+
+    try:
+        n = int(word, 0)
+    except ValueError:
+        raise CompileError('expected a number, got %r' % word)
+    if n < low or n > high:
+        raise CompileError('%d is not within %d and %d' % (n, low, high))
+    return n
+
+def word(n):
+    """ high byte first """
+
+    return [n >> 8, n & 0xff]
+
+def color(name):
+    if name not in COLORS:
+        raise CompileError('unknown color %r' % name)
+    return COLORS[name]
+
+def args(words, low, high):
+    if len(words) < low or len(words) > high:
+        if low == high:
+            raise CompileError('expected %d arguments' % low)
+        raise CompileError('expected %d to %d arguments' % (low, high))
+
+def compile_anim(lines):
+    """ byte code of an animation, header first """
+
+    delays = [4, 1, 64]
+    passes = 100
+    code = []
+    depth = 0
+    shows = False
+
+    for lineno, line in enumerate(lines, 1):
+        words = line.split('#')[0].split()
+        if not words:
+            continue
+        op, rest = words[0], words[1:]
+        try:
+            if op == 'delay':
+                args(rest, 3, 3)
+                delays = [number(w, 1, 255) for w in rest]
+                if not delays[1] <= delays[0] <= delays[2]:
+                    raise CompileError('the nominal delay must be within the limits')
+            elif op == 'passes':
+                args(rest, 1, 1)
+                passes = number(rest[0], 1, 0xffff)
+            elif op == 'clear':
+                args(rest, 0, 0)
+                code += [CLEAR]
+            elif op == 'fill':
+                args(rest, 2, 3)
+                if len(rest) == 2:
+                    if rest[0] not in SIDES:
+                        raise CompileError('unknown side %r' % rest[0])
+                    start, end = SIDES[rest[0]]
+                else:
+                    start = number(rest[0], 0, N_LEDS)
+                    end = number(rest[1], start, N_LEDS)
+                code += [FILL] + word(start) + word(end) + [color(rest[-1])]
+            elif op == 'ring':
+                args(rest, 1, 1)
+                code += [RING, number(rest[0], 0, N_RINGS - 1)]
+            elif op == 'color':
+                args(rest, 4, 4)
+                code += [COLOR, color(rest[0])] + [number(w, 0, 255) for w in rest[1:]]
+            elif op == 'show':
+                args(rest, 0, 1)
+                code += [SHOW, number(rest[0], 0, 255) if rest else MAX_LEVEL]
+                shows = True
+            elif op == 'wait':
+                args(rest, 0, 1)
+                code += [WAIT, number(rest[0], 0, 255) if rest else 1]
+            elif op == 'repeat':
+                args(rest, 1, 1)
+                if depth == MAX_DEPTH:
+                    raise CompileError('more than %d nested repeats' % MAX_DEPTH)
+                depth += 1
+                code += [LOOP, number(rest[0], 1, 256) & 0xff]
+            elif op == 'next':
+                args(rest, 0, 0)
+                if depth == 0:
+                    raise CompileError('next without repeat')
+                depth -= 1
+                code += [NEXT]
+            elif op == 'race':
+                args(rest, 0, 2)
+                width = 0
+                direction = 0
+                for w in rest:
+                    if w == 'reverse':
+                        direction = 1
+                    else:
+                        width = number(w, 1, 60)
+                code += [RACE, width, direction]
+            elif op == 'copy':
+                args(rest, 3, 3)
+                start = number(rest[0], 0, N_LEDS)
+                end = number(rest[1], start, N_LEDS)
+                to = number(rest[2], 0, N_LEDS - (end - start))
+                code += [COPY] + word(to) + word(start) + word(end - start)
+            else:
+                raise CompileError('unknown statement %r' % op)
+        except CompileError as e:
+            raise CompileError('line %d: %s' % (lineno, e))
+
+    if depth:
+        raise CompileError('repeat without next')
+    if not shows:
+        raise CompileError('the animation never shows a frame')
+
+    return bytes(delays + [passes >> 8, passes & 0xff] + code + [END])
+
+def c_array(name, data):
+    rows = []
+    for i in range(0, len(data), 12):
+        rows.append('    ' + ' '.join('0x%02x,' % b for b in data[i:i + 12]))
+    return 'const uint8_t %s[] PROGMEM = {\n%s\n};\n' % (name, '\n'.join(rows))
+
+def header(anims):
+    """ anim_programs.h for a list of (path, name, code) """
+
+    out = ['// Animation programs, generated by tvanimc.py from',
+           '// ' + ' '.join(path for path, _, _ in anims),
+           '// do not edit',
+           '',
+           '#ifndef ANIM_PROGRAMS_H_',
+           '#define ANIM_PROGRAMS_H_',
+           '',
+           '#define _N_ANIM %d' % len(anims),
+           '#define _ANIM_NAMES %s' % ', '.join('"%s"' % name for _, name, _ in anims),
+           '',
+           '#endif /* ANIM_PROGRAMS_H_ */',
+           '',
+           '// the programs are only defined in tvanim.c',
+           '#if defined(ANIM_PROGRAMS) && !defined(ANIM_PROGRAMS_DEFINED)',
+           '#define ANIM_PROGRAMS_DEFINED',
+           '']
+    for _, name, code in anims:
+        out.append('// %s, %d bytes' % (name, len(code)))
+        out.append(c_array('anim_prog_%s' % name, code))
+    out.append('const uint8_t * const anim_programs[_N_ANIM] PROGMEM = {')
+    out.append('    ' + ', '.join('anim_prog_%s' % name for _, name, _ in anims) + ',')
+    out.append('};')
+    out.append('')
+    out.append('#endif')
+    return '\n'.join(out) + '\n'
+
+def main(argv):
+    out = None
+    if len(argv) > 1 and argv[0] == '-o':
+        out = argv[1]
+        argv = argv[2:]
+    if not argv:
+        print(__doc__.strip())
+        return 1
+
+    anims = []
+    for path in argv:
+        name = os.path.splitext(os.path.basename(path))[0]
+        if not name.isidentifier():
+            sys.stderr.write('%s: the name must be a C identifier\n' % path)
+            return 1
+        with open(path) as f:
+            try:
+                anims.append((path, name, compile_anim(f)))
+            except CompileError as e:
+                sys.stderr.write('%s: %s\n' % (path, e))
+                return 1
+
+    text = header(anims)
+    if out is None:
+        sys.stdout.write(text)
+    else:
+        with open(out, 'w') as f:
+            f.write(text)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,222 @@
+"""
+Encode frames for streaming to the TV sign
+
+A frame is a list with one palette index per LED
+(0 off, 1 violet, 2 beige, 3 yellow, 4 cyan).  It can
+be sent as raw bytes (0xa8 packets, two LEDs per byte)
+or as codes (0xa9 packets) which the firmware decodes
+into its frame buffer as they arrive, see tvframe.h:
+
+  0ccc nnnn        run of n+1 LEDs of color c
+  1000 0ccc, n     run of n LEDs of color c, n = 0 is 256
+  1001 0000, h, l  move the cursor to LED h*256+l
+  11nn nnnn        skip n+1 LEDs
+
+A coded frame is either the whole frame as runs or
+only the LEDs that changed since the previous frame,
+whichever is shorter.
+
+Run as a script to print the compression of frame
+files, e.g. those written by obj/tvdump.
+"""
+
+import sys
+
+N_LEDS = 540
+FRAME_BYTES = (N_LEDS + 1) // 2
+# largest packet the firmware takes
+MAX_PACKET = 255
+
+CODE_LONG_RUN = 0x80
+CODE_SEEK = 0x90
+CODE_SKIP = 0xc0
+
+def read_frames(path):
+    """
+    Read a frame sequence, one frame per line
+    with one palette index (0-4) per LED.
+    Short lines leave the remaining LEDs off,
+    blank lines and lines starting with # are
+    skipped
+    """
+
+    frames = []
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith('#'):
+                continue
+            leds = [int(x) for x in line.replace(' ', '')[:N_LEDS]]
+            frames.append(leds + [0] * (N_LEDS - len(leds)))
+
+    return frames
+
+def pack(leds):
+    """ two LEDs per byte, the even LED in the low nibble """
+
+    padded = leds + [0] * (FRAME_BYTES * 2 - len(leds))
+    return bytes(padded[i] | (padded[i + 1] << 4) for i in range(0, len(padded), 2))
+
+def encode_runs(leds, start, end):
+    """ codes for leds[start:end] with the cursor at start """
+
+    codes = []
+    i = start
+    while i < end:
+        color = leds[i]
+        n = 1
+        while i + n < end and leds[i + n] == color:
+            n += 1
+        i += n
+        while n > 0:
+            if n <= 16:
+                codes.append(bytes([(color << 4) | (n - 1)]))
+                n = 0
+            else:
+                m = min(n, 256)
+                codes.append(bytes([CODE_LONG_RUN | color, m & 0xff]))
+                n -= m
+
+    return codes
+
+def encode_move(cursor, target):
+    """ codes that move the cursor forward to target """
+
+    gap = target - cursor
+    if gap <= 0:
+        return []
+    if gap <= 128:
+        codes = []
+        while gap > 0:
+            n = min(gap, 64)
+            codes.append(bytes([CODE_SKIP | (n - 1)]))
+            gap -= n
+        return codes
+    return [bytes([CODE_SEEK, target >> 8, target & 0xff])]
+
+def encode_delta(prev, leds):
+    """ codes for the LEDs that differ from prev """
+
+    codes = []
+    cursor = 0
+    i = 0
+    while i < N_LEDS:
+        if leds[i] == prev[i]:
+            i += 1
+            continue
+        end = i
+        while end < N_LEDS and leds[end] != prev[end]:
+            end += 1
+        codes += encode_move(cursor, i)
+        codes += encode_runs(leds, i, end)
+        cursor = end
+        i = end
+
+    return codes
+
+def encode(prev, leds):
+    """ the shorter of the full and the delta coding """
+
+    full = encode_runs(leds, 0, N_LEDS)
+    if prev is None:
+        return full
+    delta = encode_delta(prev, leds)
+    if sum(map(len, delta)) < sum(map(len, full)):
+        return delta
+    return full
+
+def code_packets(codes):
+    """
+    Group codes into 0xa9 packets.  The cursor
+    starts at LED 0 in every packet, so a packet
+    that starts part way through the frame first
+    moves it.  Codes are never split
+    """
+
+    packets = b''
+    payload = b''
+    cursor = 0
+    for code in codes:
+        if len(payload) + len(code) > MAX_PACKET:
+            packets += bytes([0xa9, len(payload)]) + payload
+            payload = b''
+            if code[0] != CODE_SEEK:
+                payload = bytes([CODE_SEEK, cursor >> 8, cursor & 0xff])
+        payload += code
+        cursor = advance(cursor, code)
+    if payload:
+        packets += bytes([0xa9, len(payload)]) + payload
+
+    return packets
+
+def advance(cursor, code):
+    """ cursor after a code """
+
+    op = code[0]
+    if op < CODE_LONG_RUN:
+        return cursor + (op & 0x0f) + 1
+    if op >= CODE_SKIP:
+        return cursor + (op & 0x3f) + 1
+    if op == CODE_SEEK:
+        return (code[1] << 8) | code[2]
+    return cursor + (code[1] or 256)
+
+def raw_packets(prev, leds):
+    """
+    0xa8 packets with the bytes from the first
+    to the last one that changed
+    """
+
+    data = pack(leds)
+    if prev is None:
+        first, last = 0, FRAME_BYTES
+    else:
+        old = pack(prev)
+        changed = [i for i in range(FRAME_BYTES) if data[i] != old[i]]
+        if not changed:
+            return b''
+        first, last = changed[0], changed[-1] + 1
+
+    packets = b''
+    for pos in range(first, last, MAX_PACKET):
+        count = min(MAX_PACKET, last - pos)
+        packets += bytes([0xa8, count, pos >> 8, pos & 0xff]) + data[pos:pos + count]
+
+    return packets
+
+def frame_packets(prev, leds):
+    """ the shortest packets that turn prev into leds """
+
+    if prev is not None and leds == prev:
+        return b''
+    coded = code_packets(encode(prev, leds))
+    raw = raw_packets(prev, leds)
+    return coded if len(coded) <= len(raw) else raw
+
+def report(path):
+    """ print the bytes needed to stream a frame file """
+
+    frames = read_frames(path)
+    if not frames:
+        print('%-24s no frames' % path)
+        return
+
+    rgb = 3 * N_LEDS * len(frames)
+    full = len(raw_packets(None, frames[0])) * len(frames)
+    raw = 0
+    coded = 0
+    prev = None
+    for leds in frames:
+        raw += len(raw_packets(prev, leds))
+        coded += len(frame_packets(prev, leds))
+        prev = leds
+
+    print('%-24s %7d %9.1f %9.1f %9.1f %8.1f %8.1f' % (
+        path, len(frames), float(full) / len(frames), float(raw) / len(frames),
+        float(coded) / len(frames), float(rgb) / max(coded, 1), float(full) / max(coded, 1)))
+
+if __name__ == '__main__':
+    print('%-24s %7s %9s %9s %9s %8s %8s' % (
+        'file', 'frames', 'packed', 'changed', 'coded', 'vs rgb', 'vs packed'))
+    for path in sys.argv[1:]:
+        report(path)
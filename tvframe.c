@@ -0,0 +1,771 @@
+//
+// Palette indexed frame buffer for the TV sign
+//
+// 540 LEDs take 270 bytes instead of the
+// 1620 bytes of a cRGB array.  Filling or
+// clearing a range writes two LEDs per byte.
+//
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include <string.h>
+#include "light_ws2812.h"
+#include "tvframe.h"
+#include "tvstats.h"
+#include "bench_markers.h"
+
+uint8_t led[_FB_BYTES];
+
+// These are the main TV colors
+// see tvpatterns.c for how they
+// were matched
+volatile uint8_t palette[_N_COLORS][3] = {
+    {0, 0, 0},  // off
+    {8, 0, 1},  // violet
+    {8, 3, 1},  // beige
+    {8, 3, 0},  // yellow
+    {0, 3, 4},  // cyan
+};
+
+// Ring geometry
+//
+// Every ring of the sign as runs of LEDs
+// on each side, sorted by the first LED.
+// ring_first[] holds the index of the
+// first span of each ring
+const struct span ring_spans[] PROGMEM = {
+    // ring 0
+    {  0, 11, _VIOLET}, { 53, 17, _VIOLET}, { 74, 16, _VIOLET},
+    {237, 16, _BEIGE},
+    {347, 22, _YELLOW},
+    {420, 17, _CYAN}, {481, 17, _CYAN}, {529, 11, _CYAN},
+    // ring 1
+    { 11,  1, _VIOLET}, { 34, 19, _VIOLET}, { 72,  1, _VIOLET},
+    { 90,  1, _VIOLET}, { 92, 13, _VIOLET}, {122, 20, _VIOLET},
+    {209, 28, _BEIGE},
+    {307, 40, _YELLOW},
+    {397, 20, _CYAN}, {419,  1, _CYAN}, {437,  1, _CYAN},
+    {462, 19, _CYAN}, {513, 14, _CYAN}, {528,  1, _CYAN},
+    // ring 2
+    { 12, 22, _VIOLET}, { 70,  1, _VIOLET}, { 91,  1, _VIOLET},
+    {105, 17, _VIOLET}, {144, 26, _VIOLET},
+    {170, 39, _BEIGE},
+    {253, 54, _YELLOW},
+    {369, 26, _CYAN}, {417,  2, _CYAN}, {440, 22, _CYAN},
+    {498, 15, _CYAN}, {526,  2, _CYAN},
+};
+
+const uint8_t ring_first[_N_RINGS + 1] PROGMEM = {0, 8, 22, 34};
+
+// race steps of violet, beige, yellow and cyan
+#include "race_geometry.h"
+
+// Output stage
+//
+// Every color byte sent goes through
+// out_lut, which holds the brightness
+// scale.  The table is rebuilt by the
+// next show_leds() after the brightness
+// changes, and the palette is only
+// rescaled when a color, the brightness
+// or the level of the frame changed.
+//
+// The scale is perceptual: a color byte
+// is taken back through the gamma curve,
+// scaled and put through the curve again.
+// A channel that is lit stays at least 1,
+// so dim colors keep their hue rather
+// than losing a channel
+static uint8_t out_lut[256];
+static uint16_t out_scale = _FULL_SCALE;
+static volatile uint8_t lut_valid = 0;
+static volatile uint8_t scaled_valid = 0;
+static uint8_t scaled_level = 0;
+
+// palette after level and output stage
+static struct cRGB scaled[_N_COLORS];
+
+// Change tracking
+//
+// sent[] is the frame buffer as it was
+// last clocked out.  A frame that matches
+// it with the same scaled palette is not
+// sent again, which saves the whole
+// transmit whenever a pattern redraws
+// the same step
+//
+// LEDs keep their color when fewer are
+// clocked out than the chain holds, so
+// a frame is only sent up to the last
+// LED that changed
+static uint8_t sent[_FB_BYTES];
+
+// frames sent and skipped as unchanged
+volatile uint16_t fb_sent = 0;
+volatile uint16_t fb_elided = 0;
+
+// Cross-fade
+//
+// fb_fade() keeps the frame on the sign in
+// fade_from[] and its colors in fade_scaled[].
+// That is the frame last sent, or in the
+// middle of a fade the blend last sent, whose
+// colors are the slots below.
+// For the next frames every LED is sent as a
+// blend of its old and its new color.  Each
+// pair of different old and new palette
+// entries gets one of the palette slots after
+// the _N_COLORS, up to _FADE_SLOTS, and the
+// entries of every slot move from the old to
+// the new color by an 8 bit fixed point lerp.
+// The blended indices are built in sent[]
+// and sent instead of led[], so a fade needs
+// no RGB buffer.  A pair that finds no free
+// slot shows its new color at once, but for
+// a blend, which fades from its nearer end
+#define _FADE_SLOTS 16
+static uint8_t fade_from[_FB_BYTES];
+static struct cRGB fade_scaled[_FADE_SLOTS];
+static struct cRGB fade_palette[_FADE_SLOTS];
+// slot of each old and new entry, 0 if none yet
+static uint8_t fade_slot[_FADE_SLOTS][_N_COLORS];
+// old and new entry of each slot, old in the
+// high nibble
+static uint8_t fade_pair[_FADE_SLOTS];
+// Set while fade_from[] holds a blend.  The
+// entry of the nearer end of that blend for
+// each of its slots, a slot that finds no
+// free pair fades from that entry instead
+static uint8_t fade_mixed = 0;
+static uint8_t fade_near[_FADE_SLOTS];
+static uint8_t fade_slots;
+// frames of the fade and the frame it is at,
+// no fade runs while fade_step is 0
+static uint8_t fade_frames = 0;
+static uint8_t fade_step = 0;
+// a frame of the fade was sent since the
+// last fb_fade_frame()
+static uint8_t fade_shown = 0;
+
+// set the output scale, _FULL_SCALE
+// sends the colors unchanged
+void fb_brightness(uint16_t scale)
+{
+    out_scale = scale;
+    lut_valid = 0;
+}
+
+// rescale the palette on the next frame
+// after a color has been changed
+void fb_palette_changed()
+{
+    scaled_valid = 0;
+}
+
+// 255 * (i / 255)^2.2, the light of the
+// LEDs for a perceived brightness i
+static const uint8_t gamma_curve[256] PROGMEM = {
+      0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   0,   1,
+      1,   1,   1,   1,   1,   1,   1,   1,   1,   2,   2,   2,   2,   2,   2,   2,
+      3,   3,   3,   3,   3,   4,   4,   4,   4,   5,   5,   5,   5,   6,   6,   6,
+      6,   7,   7,   7,   8,   8,   8,   9,   9,   9,  10,  10,  11,  11,  11,  12,
+     12,  13,  13,  13,  14,  14,  15,  15,  16,  16,  17,  17,  18,  18,  19,  19,
+     20,  20,  21,  22,  22,  23,  23,  24,  25,  25,  26,  26,  27,  28,  28,  29,
+     30,  30,  31,  32,  33,  33,  34,  35,  35,  36,  37,  38,  39,  39,  40,  41,
+     42,  43,  43,  44,  45,  46,  47,  48,  49,  49,  50,  51,  52,  53,  54,  55,
+     56,  57,  58,  59,  60,  61,  62,  63,  64,  65,  66,  67,  68,  69,  70,  71,
+     73,  74,  75,  76,  77,  78,  79,  81,  82,  83,  84,  85,  87,  88,  89,  90,
+     91,  93,  94,  95,  97,  98,  99, 100, 102, 103, 105, 106, 107, 109, 110, 111,
+    113, 114, 116, 117, 119, 120, 121, 123, 124, 126, 127, 129, 130, 132, 133, 135,
+    137, 138, 140, 141, 143, 145, 146, 148, 149, 151, 153, 154, 156, 158, 159, 161,
+    163, 165, 166, 168, 170, 172, 173, 175, 177, 179, 181, 182, 184, 186, 188, 190,
+    192, 194, 196, 197, 199, 201, 203, 205, 207, 209, 211, 213, 215, 217, 219, 221,
+    223, 225, 227, 229, 231, 234, 236, 238, 240, 242, 244, 246, 248, 251, 253, 255,
+};
+
+static void build_lut()
+{
+    uint16_t scale = out_scale;
+    // perceived brightness of v, the first
+    // step of the curve that reaches it.
+    // Both only grow with v
+    uint16_t p = 0;
+    for( uint16_t v = 0; v < 256; v++ ) {
+        if( scale >= _FULL_SCALE ) {
+            out_lut[v] = v;
+            continue;
+        }
+        while( pgm_read_byte(&gamma_curve[p]) < v ) {
+            p++;
+        }
+        uint8_t out = pgm_read_byte(&gamma_curve[(p*scale + 128) >> 8]);
+        if( out == 0 && v != 0 && scale != 0 ) {
+            out = 1;
+        }
+        out_lut[v] = out;
+    }
+    lut_valid = 1;
+    scaled_valid = 0;
+}
+
+// set one LED to a palette entry
+void fb_set(uint16_t il, uint8_t color)
+{
+    uint8_t *pair = &led[il >> 1];
+    if( il & 1 ) {
+        *pair = (*pair & 0x0f) | (color << 4);
+    }
+    else {
+        *pair = (*pair & 0xf0) | color;
+    }
+}
+
+// palette entry of one LED
+uint8_t fb_get(uint16_t il)
+{
+    uint8_t pair = led[il >> 1];
+    return (il & 1) ? pair >> 4 : pair & 0x0f;
+}
+
+// set the LEDs from start up to
+// but not including end to a
+// palette entry
+void fb_fill(uint16_t start, uint16_t end, uint8_t color)
+{
+    if( start >= end ) {
+        return;
+    }
+    // odd first LED shares a byte
+    if( start & 1 ) {
+        fb_set(start, color);
+        start++;
+    }
+    // odd last LED shares a byte
+    if( end & 1 ) {
+        end--;
+        fb_set(end, color);
+    }
+    uint8_t *p = &led[start >> 1];
+    uint8_t *stop = &led[end >> 1];
+    uint8_t both = color | (color << 4);
+    while( p < stop ) {
+        *p++ = both;
+    }
+}
+
+// copy n LEDs from src to dst, the ranges
+// may overlap.  When both start at the same
+// side of a pair the LEDs in between are
+// copied a byte at a time, otherwise every
+// LED is shifted into the other nibble
+void fb_copy(uint16_t dst, uint16_t src, uint16_t n)
+{
+    if( n == 0 || dst == src ) {
+        return;
+    }
+    if( (dst ^ src) & 1 ) {
+        if( dst < src ) {
+            for( uint16_t i = 0; i < n; i++ ) {
+                fb_set(dst + i, fb_get(src + i));
+            }
+        }
+        else {
+            while( n-- ) {
+                fb_set(dst + n, fb_get(src + n));
+            }
+        }
+        return;
+    }
+
+    // LEDs before and after the whole pairs,
+    // copied on the side that is not written
+    // over by the pairs
+    uint16_t head = dst & 1;
+    uint16_t tail = (n - head) & 1;
+    uint16_t last = n - 1;
+    if( dst < src && head ) {
+        fb_set(dst, fb_get(src));
+    }
+    if( dst > src && tail ) {
+        fb_set(dst + last, fb_get(src + last));
+    }
+    memmove(&led[(dst + head) >> 1], &led[(src + head) >> 1], (n - head) >> 1);
+    if( dst > src && head ) {
+        fb_set(dst, fb_get(src));
+    }
+    if( dst < src && tail ) {
+        fb_set(dst + last, fb_get(src + last));
+    }
+}
+
+// light every LED in the color of its side
+void fb_sides()
+{
+    fb_fill(_START_VIOLET, _START_BEIGE, _VIOLET);
+    fb_fill(_START_BEIGE, _START_YELLOW, _BEIGE);
+    fb_fill(_START_YELLOW, _START_CYAN, _YELLOW);
+    fb_fill(_START_CYAN, _MAX_LED, _CYAN);
+}
+
+// pairs of LEDs from the start of the
+// buffer up to the last pair in
+// [start, end) that differs from the
+// frame last sent, 0 if none does
+static uint16_t fb_extent(uint16_t start, uint16_t end)
+{
+    while( end > start ) {
+        end--;
+        if( led[end] != sent[end] ) {
+            return end + 1;
+        }
+    }
+    return 0;
+}
+
+#if defined(ws2812_parallel)
+// first LED of each lane and the end of the last
+static const uint16_t lane_start[5] = {
+    _START_VIOLET, _START_BEIGE, _START_YELLOW, _START_CYAN, _MAX_LED
+};
+
+// LEDs to send on every lane so that each
+// lane reaches its last changed LED
+static uint16_t fb_lane_extent()
+{
+    uint16_t leds = 0;
+    for( uint8_t il = 0; il < 4; il++ ) {
+        uint16_t start = lane_start[il];
+        uint16_t end = lane_start[il+1];
+        uint16_t pairs = fb_extent(start >> 1, (end + 1) >> 1);
+        if( pairs ) {
+            uint16_t n = 2*pairs - start;
+            if( n > end - start ) {
+                n = end - start;
+            }
+            if( n > leds ) {
+                leds = n;
+            }
+        }
+    }
+    return leds;
+}
+#endif
+
+// set every LED of the spans, which are
+// stored in program memory, to the color
+// of its span
+void fb_spans(const struct span *spans, uint8_t n)
+{
+    while( n-- ) {
+        uint16_t start = pgm_read_word(&spans->start);
+        uint8_t length = pgm_read_byte(&spans->length);
+        uint8_t color = pgm_read_byte(&spans->color);
+        fb_fill(start, start + length, color);
+        spans++;
+    }
+}
+
+// light one ring in the colors of its sides
+void fb_ring(uint8_t ring)
+{
+    uint8_t first = pgm_read_byte(&ring_first[ring]);
+    uint8_t last = pgm_read_byte(&ring_first[ring + 1]);
+    fb_spans(&ring_spans[first], last - first);
+}
+
+// light one ring on some sides only, bit c
+// of sides stands for palette entry c
+void fb_ring_sides(uint8_t ring, uint8_t sides)
+{
+    uint8_t first = pgm_read_byte(&ring_first[ring]);
+    uint8_t last = pgm_read_byte(&ring_first[ring + 1]);
+    const struct span *span = &ring_spans[first];
+    for( uint8_t n = last - first; n; n--, span++ ) {
+        uint8_t color = pgm_read_byte(&span->color);
+        if( sides & (1 << color) ) {
+            uint16_t start = pgm_read_word(&span->start);
+            fb_fill(start, start + pgm_read_byte(&span->length), color);
+        }
+    }
+}
+
+// number of steps of a race table
+uint8_t race_rows(uint8_t table)
+{
+    return pgm_read_byte(&race_tables[table].rows);
+}
+
+// palette entry a race table is drawn in
+uint8_t race_color(uint8_t table)
+{
+    return pgm_read_byte(&race_tables[table].color);
+}
+
+// put a cursor on step 0 of a table
+void race_start(struct race_cursor *c, uint8_t table)
+{
+    const struct race_table *t = &race_tables[table];
+    for( uint8_t col = 0; col < 3; col++ ) {
+        c->led[col] = pgm_read_word(&t->first[col]);
+    }
+    c->row = 0;
+    c->rows = pgm_read_byte(&t->rows);
+    c->deltas = pgm_read_ptr(&t->deltas);
+    c->delta = c->deltas;
+}
+
+// move a cursor to the previous step
+void race_prev(struct race_cursor *c)
+{
+    if( c->row == 0 ) {
+        c->row = c->rows;
+        c->delta = c->deltas + 3 * c->rows;
+    }
+    c->row--;
+
+    // undo the move into the current step
+    const int8_t *d = c->delta - 3;
+    c->led[0] -= (int8_t)pgm_read_byte(d);
+    c->led[1] -= (int8_t)pgm_read_byte(d + 1);
+    c->led[2] -= (int8_t)pgm_read_byte(d + 2);
+    c->delta = d;
+}
+
+// move a cursor to a step the shorter way round
+void race_seek(struct race_cursor *c, uint8_t row)
+{
+    uint8_t rows = c->rows;
+    uint8_t ahead = row >= c->row ? row - c->row : row + rows - c->row;
+    if( ahead <= rows / 2 ) {
+        while( ahead-- ) {
+            race_next(c);
+        }
+    }
+    else {
+        for( ahead = rows - ahead; ahead; ahead-- ) {
+            race_prev(c);
+        }
+    }
+}
+
+// decoder state, see tvframe.h
+static uint16_t code_led;
+static uint8_t code_op;
+static uint8_t code_need;
+static uint8_t code_hi;
+
+// fill from the cursor on and move past the
+// run, clipped to the end of the sign
+static void code_run(uint16_t n, uint8_t color)
+{
+    uint16_t end = code_led + n;
+    if( end > _MAX_LED ) {
+        end = _MAX_LED;
+    }
+    if( color < _N_COLORS ) {
+        fb_fill(code_led, end, color);
+    }
+    code_led = end;
+}
+
+// start decoding at LED 0
+void fb_decode_start()
+{
+    code_led = 0;
+    code_need = 0;
+}
+
+// apply the next byte of a coded frame
+void fb_decode(uint8_t code)
+{
+    if( code_need ) {
+        code_need--;
+        if( code_op == _CODE_SEEK ) {
+            if( code_need ) {
+                code_hi = code;
+            }
+            else {
+                code_led = (code_hi << 8) | code;
+            }
+        }
+        else {
+            code_run(code ? code : 256, code_op & 0x07);
+        }
+    }
+    else if( code < _CODE_LONG_RUN ) {
+        code_run((code & 0x0f) + 1, code >> 4);
+    }
+    else if( code >= _CODE_SKIP ) {
+        code_led += (code & 0x3f) + 1;
+    }
+    else if( code == _CODE_SEEK ) {
+        code_op = code;
+        code_need = 2;
+    }
+    else if( code < _CODE_LONG_RUN + 8 ) {
+        code_op = code;
+        code_need = 1;
+    }
+}
+
+// turn off all LEDs
+void fb_clear()
+{
+    uint8_t *p = led;
+    uint8_t *stop = led + _FB_BYTES;
+    while( p < stop ) {
+        *p++ = 0;
+    }
+}
+
+// blend the old and new color of every LED
+// over frames frames starting with the next
+// show_leds(), 0 stops a fade
+void fb_fade(uint8_t frames)
+{
+    // The fade starts from what the sign
+    // shows.  A fade cut short starts over
+    // from the blend it sent last, or from
+    // where it started if it sent none yet
+    if( frames && fade_step > 1 ) {
+        memcpy(fade_from, sent, _FB_BYTES);
+        memcpy(fade_scaled, fade_palette, sizeof(fade_scaled));
+        // the old end of a slot may itself be
+        // a blend of the fade before
+        uint8_t near[_FADE_SLOTS];
+        uint8_t half = (fade_step - 1) * 2 < fade_frames;
+        for( uint8_t slot = 0; slot < _FADE_SLOTS; slot++ ) {
+            uint8_t end = half ? fade_pair[slot] >> 4 : fade_pair[slot] & 0x0f;
+            if( end >= _N_COLORS ) {
+                end = fade_mixed ? fade_near[end] : 0;
+            }
+            near[slot] = end;
+        }
+        memcpy(fade_near, near, sizeof(near));
+        fade_mixed = 1;
+    }
+    else if( frames && !fade_step ) {
+        memcpy(fade_from, sent, _FB_BYTES);
+        memcpy(fade_scaled, scaled, sizeof(scaled));
+        fade_mixed = 0;
+    }
+    fade_frames = frames;
+    fade_step = frames ? 1 : 0;
+}
+
+// send a frame of the fade even if the
+// pattern drew nothing in this one, call
+// once per frame after the pattern
+void fb_fade_frame()
+{
+    if( fade_step && !fade_shown ) {
+        show_leds(scaled_level);
+    }
+    fade_shown = 0;
+}
+
+// palette slot of an LED going from color
+// from, an entry of fade_scaled, to color to
+static uint8_t fade_index(uint8_t from, uint8_t to)
+{
+    if( from == to || to >= _N_COLORS ) {
+        return to;
+    }
+    uint8_t slot = fade_slot[from][to];
+    if( slot == 0 ) {
+        if( fade_slots == _FADE_SLOTS ) {
+            if( from >= _N_COLORS ) {
+                return fade_index(fade_near[from], to);
+            }
+            return to;
+        }
+        slot = fade_slots++;
+        fade_slot[from][to] = slot;
+        fade_pair[slot] = (from << 4) | to;
+    }
+    return slot;
+}
+
+// one channel t/256 of the way from a to b
+static uint8_t fade_lerp(uint8_t a, uint8_t b, uint16_t t)
+{
+    return (a*(256 - t) + b*t) >> 8;
+}
+
+// build the blended frame in sent[] and the
+// colors of its slots
+static void fade_blend(uint16_t t)
+{
+    memset(fade_slot, 0, sizeof(fade_slot));
+    fade_slots = _N_COLORS;
+    for( uint8_t ic = 0; ic < _N_COLORS; ic++ ) {
+        fade_pair[ic] = (ic << 4) | ic;
+    }
+
+    // the pairs from plain entries, and from
+    // the nearer end of each blend, get their
+    // slots first so the blends in fade_from
+    // cannot take them all
+    if( fade_mixed ) {
+        for( uint16_t i = 0; i < _FB_BYTES; i++ ) {
+            uint8_t lo = fade_from[i] & 0x0f;
+            uint8_t hi = fade_from[i] >> 4;
+            if( lo >= _N_COLORS ) {
+                lo = fade_near[lo];
+            }
+            if( hi >= _N_COLORS ) {
+                hi = fade_near[hi];
+            }
+            fade_index(lo, led[i] & 0x0f);
+            fade_index(hi, led[i] >> 4);
+        }
+    }
+
+    uint8_t *from = fade_from;
+    uint8_t *to = led;
+    uint8_t *out = sent;
+    uint8_t *stop = led + _FB_BYTES;
+    while( to < stop ) {
+        uint8_t a = *from++;
+        uint8_t b = *to++;
+        if( a == b ) {
+            *out++ = b;
+        }
+        else {
+            *out++ = fade_index(a & 0x0f, b & 0x0f) | (fade_index(a >> 4, b >> 4) << 4);
+        }
+    }
+
+    for( uint8_t slot = 0; slot < fade_slots; slot++ ) {
+        struct cRGB *a = &fade_scaled[fade_pair[slot] >> 4];
+        struct cRGB *b = &scaled[fade_pair[slot] & 0x0f];
+        fade_palette[slot].r = fade_lerp(a->r, b->r, t);
+        fade_palette[slot].g = fade_lerp(a->g, b->g, t);
+        fade_palette[slot].b = fade_lerp(a->b, b->b, t);
+    }
+}
+
+// send the frame to the sign with every
+// palette color multiplied by level and
+// passed through the output stage,
+// one side per data pin when the
+// parallel output is enabled.  Nothing
+// is sent if the frame is unchanged, and
+// only up to the last changed LED if
+// the palette is the same
+void show_leds(uint8_t level)
+{
+    uint8_t changed = 0;
+    if( !lut_valid ) {
+        build_lut();
+    }
+    if( !scaled_valid || level != scaled_level ) {
+        changed = 1;
+        scaled_valid = 1;
+        scaled_level = level;
+        for( uint8_t ic = 0; ic < _N_COLORS; ic++ ) {
+            scaled[ic].r = out_lut[(uint8_t)(palette[ic][0]*level)];
+            scaled[ic].g = out_lut[(uint8_t)(palette[ic][1]*level)];
+            scaled[ic].b = out_lut[(uint8_t)(palette[ic][2]*level)];
+        }
+    }
+    if( fade_step ) {
+        fade_shown = 1;
+        if( fade_step < fade_frames ) {
+            fade_blend(((uint16_t)fade_step << 8) / fade_frames);
+            fade_step++;
+            fb_sent++;
+            uint16_t start = clock_ticks();
+#if defined(ws2812_parallel)
+            ws2812_setleds_palette_parallel(sent, _START_VIOLET, _START_BEIGE,
+                                            _START_YELLOW, _START_CYAN, _N_LED_LANE,
+                                            fade_palette);
+#else
+            ws2812_setleds_palette(sent, _MAX_LED, fade_palette);
+#endif
+            stats_transmit(start);
+            return;
+        }
+        // the last step is the new frame,
+        // sent in full as sent[] holds the
+        // blend
+        fade_step = 0;
+        changed = 1;
+    }
+    uint16_t pairs = fb_extent(0, _FB_BYTES);
+    if( !changed && !pairs ) {
+        fb_elided++;
+        return;
+    }
+    fb_sent++;
+    uint16_t start = clock_ticks();
+#if defined(ws2812_parallel)
+    uint16_t leds = changed ? _N_LED_LANE : fb_lane_extent();
+    memcpy(sent, led, pairs);
+    ws2812_setleds_palette_parallel(led, _START_VIOLET, _START_BEIGE,
+                                    _START_YELLOW, _START_CYAN, leds, scaled);
+#else
+    uint16_t leds = _MAX_LED;
+    if( !changed && 2*pairs < _MAX_LED ) {
+        leds = 2*pairs;
+    }
+    memcpy(sent, led, pairs);
+    ws2812_setleds_palette(led, leds, scaled);
+#endif
+    stats_transmit(start);
+}
+
+#if defined(TV_BENCH_MARKERS)
+// LEDs of the RGB loop in fb_bench, the
+// whole sign does not fit in SRAM as RGB
+#define _BENCH_RGB_LEDS 64
+
+// Time the frame buffer primitives once,
+// one BENCH_RASTER pulse each, in the order
+// sim/simbench.c lists them.  The last one is
+// a loop over an RGB buffer as the patterns
+// wrote it before the palette, reloading the
+// volatile color and multiplying per LED
+void fb_bench()
+{
+    BENCH_MARK_ON(BENCH_RASTER);
+    fb_fill(0, _MAX_LED, _CYAN);
+    BENCH_MARK_OFF(BENCH_RASTER);
+
+    BENCH_MARK_ON(BENCH_RASTER);
+    fb_clear();
+    BENCH_MARK_OFF(BENCH_RASTER);
+
+    BENCH_MARK_ON(BENCH_RASTER);
+    fb_sides();
+    BENCH_MARK_OFF(BENCH_RASTER);
+
+    BENCH_MARK_ON(BENCH_RASTER);
+    fb_copy(_MAX_LED / 2, 0, _MAX_LED / 2);
+    BENCH_MARK_OFF(BENCH_RASTER);
+
+    BENCH_MARK_ON(BENCH_RASTER);
+    fb_copy(_MAX_LED / 2 + 1, 0, _MAX_LED / 2 - 1);
+    BENCH_MARK_OFF(BENCH_RASTER);
+
+    BENCH_MARK_ON(BENCH_RASTER);
+    for( uint16_t il = 0; il < _MAX_LED; il++ ) {
+        fb_set(il, _YELLOW);
+    }
+    BENCH_MARK_OFF(BENCH_RASTER);
+
+    struct cRGB rgb[_BENCH_RGB_LEDS];
+    volatile uint8_t level = 4;
+    BENCH_MARK_ON(BENCH_RASTER);
+    for( uint8_t il = 0; il < _BENCH_RGB_LEDS; il++ ) {
+        rgb[il].r = palette[_YELLOW][0]*level;
+        rgb[il].g = palette[_YELLOW][1]*level;
+        rgb[il].b = palette[_YELLOW][2]*level;
+    }
+    BENCH_MARK_OFF(BENCH_RASTER);
+
+    // keep the RGB loop from being optimized away
+    led[0] = rgb[_BENCH_RGB_LEDS - 1].g;
+    fb_clear();
+}
+#endif
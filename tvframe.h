@@ -0,0 +1,164 @@
+//
+// Palette indexed frame buffer for the TV sign
+//
+// Every LED stores a four bit index into the
+// palette instead of its RGB value.  The palette
+// is scaled to the requested level and expanded
+// to GRB bytes while the frame is sent out.
+//
+
+#ifndef TVFRAME_H_
+#define TVFRAME_H_
+
+#include <avr/io.h>
+#include <avr/pgmspace.h>
+#include "light_ws2812.h"
+
+// Number of Violet LEDs
+#define _N_LED_VIOLET 170
+// Number of Beige LEDs
+#define _N_LED_BEIGE 83
+// Number of Yellow LEDs
+#define _N_LED_YELLOW 116
+// Number of Cyan LEDs
+#define _N_LED_CYAN 170
+#define _MAX_LED (_N_LED_VIOLET + _N_LED_BEIGE + _N_LED_YELLOW + _N_LED_CYAN + 1)
+
+// define the start LED of each color
+#define _START_VIOLET 0
+#define _START_BEIGE _N_LED_VIOLET
+#define _START_YELLOW _N_LED_VIOLET + _N_LED_BEIGE
+#define _START_CYAN _N_LED_VIOLET + _N_LED_BEIGE + _N_LED_YELLOW
+
+// number of LEDs sent on every lane when the
+// four sides are driven in parallel, which is
+// the length of the longest side (cyan + 1)
+#define _N_LED_LANE (_MAX_LED - (_START_CYAN))
+
+// palette entries
+#define _OFF 0
+#define _VIOLET 1
+#define _BEIGE 2
+#define _YELLOW 3
+#define _CYAN 4
+#define _N_COLORS 5
+
+// a run of LEDs on one side of the sign
+// and the palette entry of that side
+struct span {
+    uint16_t start;
+    uint8_t length;
+    uint8_t color;
+};
+
+// rings of the sign, from the center out
+#define _N_RINGS 3
+
+// Race geometry
+//
+// Each step of the race moves three LEDs of a
+// side, one per ring.  The steps of the four
+// sides are delta coded in flash (race_geometry.h,
+// made by tvracec.py from race_steps.h): the
+// LEDs of step 0, then three signed bytes per
+// step with the change of each LED to the next
+// step.  The last step leads back to step 0.  A
+// cursor walks the steps of one table either way
+#define _N_RACE_TABLES 4
+
+struct race_table {
+    uint16_t first[3];
+    uint8_t rows;
+    uint8_t color;
+    const int8_t *deltas;
+};
+
+// the cursor keeps its table's deltas and
+// length, and the deltas of its step, so a
+// step is three reads and three adds
+struct race_cursor {
+    uint16_t led[3];
+    uint8_t row;
+    uint8_t rows;
+    const int8_t *delta;
+    const int8_t *deltas;
+};
+
+// move a cursor to the next step, inline as
+// the race calls it for every LED it redraws
+static inline void race_next(struct race_cursor *c)
+{
+    const int8_t *d = c->delta;
+    c->led[0] += (int8_t)pgm_read_byte(d);
+    c->led[1] += (int8_t)pgm_read_byte(d + 1);
+    c->led[2] += (int8_t)pgm_read_byte(d + 2);
+    if( ++c->row == c->rows ) {
+        c->row = 0;
+        c->delta = c->deltas;
+    }
+    else {
+        c->delta = d + 3;
+    }
+}
+
+// Coded frames
+//
+// A streamed frame can be sent as a list of
+// codes that fb_decode() applies one byte at
+// a time at a cursor, which starts at LED 0:
+//
+//   0ccc nnnn        run of n+1 LEDs of color c
+//   1000 0ccc, n     run of n LEDs of color c,
+//                    n = 0 is 256
+//   1001 0000, h, l  move the cursor to LED h*256+l
+//   11nn nnnn        skip n+1 LEDs
+#define _CODE_LONG_RUN 0x80
+#define _CODE_SEEK 0x90
+#define _CODE_SKIP 0xc0
+
+// bytes in the frame buffer, two LEDs per byte
+#define _FB_BYTES ((_MAX_LED + 1) / 2)
+
+// output scale of full brightness, see fb_brightness
+#define _FULL_SCALE 256
+
+// palette index of every LED, the even
+// LED of a pair is in the low nibble
+extern uint8_t led[_FB_BYTES];
+
+// frames show_leds() sent and skipped
+// because nothing had changed
+extern volatile uint16_t fb_sent;
+extern volatile uint16_t fb_elided;
+
+// minimum brightness color of each
+// palette entry, order is {R, G, B}
+extern volatile uint8_t palette[_N_COLORS][3];
+
+void fb_set(uint16_t il, uint8_t color);
+uint8_t fb_get(uint16_t il);
+void fb_fill(uint16_t start, uint16_t end, uint8_t color);
+void fb_clear(void);
+void fb_copy(uint16_t dst, uint16_t src, uint16_t n);
+void fb_sides(void);
+void fb_decode_start(void);
+void fb_decode(uint8_t code);
+void fb_spans(const struct span *spans, uint8_t n);
+void fb_ring(uint8_t ring);
+void fb_ring_sides(uint8_t ring, uint8_t sides);
+uint8_t race_rows(uint8_t table);
+uint8_t race_color(uint8_t table);
+void race_start(struct race_cursor *c, uint8_t table);
+void race_prev(struct race_cursor *c);
+void race_seek(struct race_cursor *c, uint8_t row);
+void fb_brightness(uint16_t scale);
+void fb_palette_changed(void);
+void fb_fade(uint8_t frames);
+void fb_fade_frame(void);
+void show_leds(uint8_t level);
+
+#if defined(TV_BENCH_MARKERS)
+void fb_bench(void);
+#endif
+
+#endif /* TVFRAME_H_ */
@@ -0,0 +1,312 @@
+"""
+Links to the TV LED sign
+
+All links offer send(data), recv(n), settimeout(t),
+drain() and close(), and raise LinkTimeout when the
+sign does not answer in time:
+
+  BluetoothLink  the RFCOMM connection to the sign
+  SerialLink     a serial device or pseudo-terminal,
+                 e.g. to test against a stand-in
+  DaemonLink     requests to a running LinkDaemon
+
+LinkDaemon keeps one link to the sign open, opens it
+again after a failure and serves requests from local
+clients on a Unix domain socket.  A request is one
+JSON line
+
+  {"send": "<hex bytes>", "recv": n, "timeout": seconds}
+
+and is answered with
+
+  {"data": "<hex bytes>", "ms": round trip}
+
+or {"error": "...", "ms": ...} if it failed.  Requests
+from all clients run one at a time.  The answers are
+not tagged, so the daemon drops whatever the sign
+sent before a request and after a timeout: a late
+answer is never taken as the answer to the next one.
+"""
+
+import json
+import os
+import select
+import socket
+import socketserver
+import sys
+import termios
+import threading
+import time
+import tty
+
+DEFAULT_SOCKET = '/tmp/tvsign.sock'
+
+# seconds to wait for an answer when
+# the client does not say
+DEFAULT_TIMEOUT = 5.0
+
+class LinkTimeout(Exception):
+    """ the sign did not answer in time """
+
+class BluetoothLink:
+    """ RFCOMM connection to the sign """
+
+    def __init__(self, address, uuid):
+        import bluetooth
+        self.bluetooth = bluetooth
+
+        service_matches = bluetooth.find_service(uuid=uuid, address=address)
+        if len(service_matches) == 0:
+            raise OSError("Couldn't find the SampleServer service.")
+        port = service_matches[0]["port"]
+
+        self.s = bluetooth.BluetoothSocket(bluetooth.RFCOMM)
+        self.s.connect((address, port))
+
+    def settimeout(self, timeout):
+        self.s.settimeout(timeout)
+
+    def send(self, data):
+        self.s.send(data)
+
+    def recv(self, n):
+        data = b''
+        while len(data) < n:
+            try:
+                chunk = self.s.recv(n - len(data))
+            except self.bluetooth.BluetoothError as e:
+                if 'timed out' in str(e):
+                    raise LinkTimeout()
+                raise OSError(str(e))
+            if not chunk:
+                raise OSError('connection closed')
+            data += chunk
+        return data
+
+    def drain(self):
+        """ drop the bytes received so far, returns how many """
+        dropped = 0
+        timeout = self.s.gettimeout()
+        self.s.setblocking(False)
+        try:
+            while True:
+                chunk = self.s.recv(1024)
+                if not chunk:
+                    break
+                dropped += len(chunk)
+        except self.bluetooth.BluetoothError:
+            pass
+        finally:
+            self.s.settimeout(timeout)
+        return dropped
+
+    def close(self):
+        self.s.close()
+
+class SerialLink:
+    """ the sign on a serial device or pseudo-terminal """
+
+    def __init__(self, path):
+        self.fd = os.open(path, os.O_RDWR | os.O_NOCTTY)
+        if os.isatty(self.fd):
+            tty.setraw(self.fd)
+            attrs = termios.tcgetattr(self.fd)
+            attrs[4] = attrs[5] = termios.B9600
+            termios.tcsetattr(self.fd, termios.TCSANOW, attrs)
+        self.timeout = None
+
+    def settimeout(self, timeout):
+        self.timeout = timeout
+
+    def send(self, data):
+        while data:
+            data = data[os.write(self.fd, data):]
+
+    def recv(self, n):
+        data = b''
+        end = None if self.timeout is None else time.time() + self.timeout
+        while len(data) < n:
+            wait = None if end is None else max(0, end - time.time())
+            ready, _, _ = select.select([self.fd], [], [], wait)
+            if not ready:
+                raise LinkTimeout()
+            chunk = os.read(self.fd, n - len(data))
+            if not chunk:
+                raise OSError('device closed')
+            data += chunk
+        return data
+
+    def drain(self):
+        """ drop the bytes received so far, returns how many """
+        dropped = 0
+        while select.select([self.fd], [], [], 0)[0]:
+            chunk = os.read(self.fd, 1024)
+            if not chunk:
+                break
+            dropped += len(chunk)
+        return dropped
+
+    def close(self):
+        os.close(self.fd)
+
+class DaemonLink:
+    """
+    Link through a running LinkDaemon.  Sent bytes
+    are held until the next recv() or close() so
+    that a command and its answer take one request
+    """
+
+    def __init__(self, path=DEFAULT_SOCKET):
+        self.s = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+        self.s.connect(path)
+        self.f = self.s.makefile('rwb')
+        self.pending = b''
+        self.timeout = None
+        self.latencies = []
+
+    def settimeout(self, timeout):
+        self.timeout = timeout
+
+    def send(self, data):
+        self.pending += bytes(data)
+
+    def recv(self, n):
+        return self.request(n)
+
+    def drain(self):
+        """ the daemon drains the link before every request """
+        return 0
+
+    def request(self, n):
+        msg = {'send': self.pending.hex(), 'recv': n, 'timeout': self.timeout}
+        self.pending = b''
+        self.f.write(json.dumps(msg).encode() + b'\n')
+        self.f.flush()
+        line = self.f.readline()
+        if not line:
+            raise OSError('daemon closed the connection')
+        reply = json.loads(line)
+        self.latencies.append(reply['ms'])
+        if reply.get('error') == 'timeout':
+            raise LinkTimeout()
+        if 'error' in reply:
+            raise OSError(reply['error'])
+        return bytes.fromhex(reply['data'])
+
+    def close(self):
+        if self.pending:
+            self.request(0)
+        self.s.close()
+        if self.latencies:
+            print('%d requests, round trip mean %.1f ms, max %.1f ms' % (
+                len(self.latencies), sum(self.latencies) / len(self.latencies),
+                max(self.latencies)))
+
+class LinkDaemon:
+    """
+    Holds the link to the sign open and runs the
+    requests of local clients on it.  open_link()
+    makes a new link, it is called again after the
+    link failed
+    """
+
+    def __init__(self, open_link, retries=5):
+        self.open_link = open_link
+        self.retries = retries
+        self.link = None
+        self.lock = threading.Lock()
+
+    def connect(self):
+        delay = 0.5
+        for attempt in range(self.retries):
+            try:
+                self.link = self.open_link()
+                log('connected')
+                return
+            except OSError as e:
+                log('connect failed: %s' % e)
+                if attempt + 1 < self.retries:
+                    time.sleep(delay)
+                    delay *= 2
+        raise OSError('cannot connect to the sign')
+
+    def drop(self):
+        if self.link is not None:
+            try:
+                self.link.close()
+            except OSError:
+                pass
+        self.link = None
+
+    def execute(self, data, n, timeout):
+        with self.lock:
+            start = time.time()
+            try:
+                if self.link is None:
+                    self.connect()
+                self.link.settimeout(timeout or DEFAULT_TIMEOUT)
+                # an answer that came after its
+                # request timed out
+                stale = self.link.drain()
+                if stale:
+                    log('dropped %d late bytes' % stale)
+                if data:
+                    self.link.send(data)
+                reply = {'data': self.link.recv(n).hex() if n else ''}
+            except LinkTimeout:
+                # the link is fine, the sign is slow.
+                # What it did send of the answer goes,
+                # the rest is dropped before the next
+                # request
+                self.link.drain()
+                reply = {'error': 'timeout'}
+            except OSError as e:
+                # open it again for the next request
+                self.drop()
+                reply = {'error': str(e)}
+            reply['ms'] = (time.time() - start) * 1000.0
+            log('sent %d received %d in %.1f ms%s' % (
+                len(data), n, reply['ms'],
+                ' (%s)' % reply['error'] if 'error' in reply else ''))
+            return reply
+
+    def serve(self, path=DEFAULT_SOCKET):
+        daemon = self
+
+        class Handler(socketserver.StreamRequestHandler):
+            def handle(self):
+                for line in self.rfile:
+                    try:
+                        msg = json.loads(line)
+                        data = bytes.fromhex(msg.get('send', ''))
+                        n = int(msg.get('recv', 0))
+                    except ValueError:
+                        reply = {'error': 'bad request', 'ms': 0.0}
+                    else:
+                        reply = daemon.execute(data, n, msg.get('timeout'))
+                    self.wfile.write(json.dumps(reply).encode() + b'\n')
+                    self.wfile.flush()
+
+        class Server(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+            daemon_threads = True
+
+        if os.path.exists(path):
+            os.unlink(path)
+        try:
+            self.connect()
+        except OSError as e:
+            log('%s, trying again on the first request' % e)
+        server = Server(path, Handler)
+        log('listening on %s' % path)
+        try:
+            server.serve_forever()
+        except KeyboardInterrupt:
+            pass
+        finally:
+            server.server_close()
+            os.unlink(path)
+            self.drop()
+
+def log(msg):
+    print('%s %s' % (time.strftime('%H:%M:%S'), msg))
+    sys.stdout.flush()
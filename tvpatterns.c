@@ -20,24 +20,24 @@
 #include <avr/io.h>
 #include <avr/interrupt.h>
 #include <avr/pgmspace.h>
+#include <util/crc16.h>
 #include "light_ws2812.h"
+#include "tvframe.h"
+#include "tvanim.h"
+#include "tvsound.h"
+#include "tvsettings.h"
+#include "tvstats.h"
 #include "tvpatterns.h"
+#include "bench_markers.h"
 
-// Number of Violet LEDs
-#define _N_LED_VIOLET 170
-// Number of Beige LEDs
-#define _N_LED_BEIGE 83
-// Number of Yellow LEDs
-#define _N_LED_YELLOW 116
-// Number of Cyan LEDs
-#define _N_LED_CYAN 170
-#define _MAX_LED _N_LED_VIOLET + _N_LED_BEIGE + _N_LED_YELLOW + _N_LED_CYAN + 1
-// Total number of patterns (increase if patterns are added)
-#define _N_PAT 7
-// Number of steps in race pattern
-#define _N_RACE_STEPS 63
-#define _N_RACE_STEPS_BEIGE 39
-#define _N_RACE_STEPS_YELLOW 55
+// Number of patterns written in C (increase if patterns
+// are added here).  The animations of anim_programs.h
+// follow as patterns _N_BUILTIN and up
+#define _N_BUILTIN 8
+#define _N_PAT (_N_BUILTIN + _N_ANIM)
+// the sound pattern, the only one that
+// runs the ADC
+#define _SOUND_PATTERN 7
 
 // Define cutoffs for when to move
 // to the next pattern
@@ -48,6 +48,7 @@
 #define _MAX_BREATHE 50
 #define _MAX_RACE 5000
 #define _MAX_SPARKLE 1000
+#define _MAX_SOUND 1500
 
 // maximum brightness factor
 // if it is set too high it 
@@ -55,11 +56,23 @@
 // for the power supply
 #define _MAX_BRIGHTNESS 4
 
-// define the start LED of each color
-#define _START_VIOLET 0
-#define _START_BEIGE _N_LED_VIOLET
-#define _START_YELLOW _N_LED_VIOLET + _N_LED_BEIGE
-#define _START_CYAN _N_LED_VIOLET + _N_LED_BEIGE + _N_LED_YELLOW
+// Frame scheduling
+//
+// Timer 0 ticks once per millisecond and
+// the main loop runs one frame every
+// _FRAME_MS, which leaves room for a full
+// transmit (about 16.5ms for 540 LEDs)
+// plus the render.  The pattern step
+// counters are in frames, so a speed
+// setting is the same real time for
+// every pattern
+#define _TICK_OCR ((F_CPU / 64 / 1000) - 1)
+#define _FRAME_MS 20
+// frames a new pattern fades in over
+#define _FADE_FRAMES 16
+// time the turn-on pattern holds at full
+// brightness before it moves on
+#define _TURNON_MS 2000
 
 // defines for buttons
 #define BUTTON_PATTERN 0
@@ -73,286 +86,59 @@ FUSES =
     .extended = EFUSE_DEFAULT,
 };
 
-
-// Store the colors for all LEDs
-struct cRGB led[_MAX_LED];
-
-
-// Minimum brightness color patterns
-// for each displayed color
-// order is {R, G, B}
-volatile uint8_t violet[3] = {8, 0, 1};
-volatile uint8_t cyan[3] = {0, 3, 4};
-volatile uint8_t yellow[3] = {8, 3, 0};
-volatile uint8_t beige[3] = {8, 3, 1};
+// The LED colors are stored as palette
+// indices in led[], see tvframe.c
 
 // define the delay limits for each pattern
 // these should be set so that the pattern
 // cannot become too slow or too fast
-const uint8_t max_delays[_N_PAT] = {16,64, 64, 64, 64, 64, 32};
-const uint8_t min_delays[_N_PAT] = {16,1 , 1 , 1 , 1 , 1, 1};
-const uint8_t nom_delays[_N_PAT] = {4,16 , 64 , 64 , 4 , 4, 8};
+// The delay is the number of frames
+// each step of the pattern is shown for
+// The animations carry their limits in
+// their header, see pattern_delay
+const uint8_t max_delays[_N_BUILTIN] = {16,64, 64, 4, 64, 64, 32, 16};
+const uint8_t min_delays[_N_BUILTIN] = {16,1 , 1 , 1 , 1 , 1, 1, 1};
+const uint8_t nom_delays[_N_BUILTIN] = {4,16 , 64 , 4 , 4 , 4, 8, 4};
+
+// Pattern state
+//
+// The settings and counters below are only
+// read and written by the main loop.  The
+// interrupts hand their events over through
+// rx_ring and button_queue, which are emptied
+// before each frame, so a frame sees every
+// command received before it and none that
+// arrive while it is drawn
 
 // default the starting delay
-volatile uint8_t DELAY = nom_delays[0];
+uint8_t DELAY = nom_delays[0];
 
 const uint8_t MAX_RACE_WIDTH = 60;
-volatile uint8_t race_width = 10;
-volatile uint8_t sparkle_count = 8;
-volatile int raceStepVioletCyan = 0;
-volatile int raceStepBeige = 0;
-volatile int raceStepYellow = 0;
-volatile int disable_auto_update = 0;
-
-volatile int n_wave = 0;
-volatile int n_switch = 0;
-volatile int n_breathe = 0;
-volatile int n_race = 0;
-volatile int n_sparkle = 0;
-
-// Define the LED configurations for each step
-// in the race pattern.  There are 12 entries
-// per step, separated to have 3 per color where
-// each of the 3 corresponds to a different LED ring
-// entries 0-2 = violet
-// entries 3-5 = beige 
-// entries 6-8 = yellow
-// entries 9-11 = cyan
-// generally the first in a group corresponds to the
-// inner ring, the second to the middle ring
-// and the third to the outer ring
-const uint16_t steps_race_violet[_N_RACE_STEPS][3] PROGMEM = {
-                {0,   92,  120},
-                {1,   93,  119},
-                {2,   94,  118},
-                {3,   95,  117},
-                {4,   96,  116},
-                {5,   97,  115},
-                {6,   98,  114},
-                {7,   99,  113},
-                {8,   100, 112},
-                {9,   101, 111},
-                {9,   102, 110},
-                {9,   102, 109},
-                {10,  103, 108},
-                {10,  104, 107},
-                {10,  105, 106},
-                {10,  11,  12},
-                {10,  11,  13},
-                {10,  52,  14},
-                {53,  51,  15},
-                {54,  50,  16},
-                {55,  49,  17},
-                {56,  48,  18},
-                {57,  47,  19},
-                {58,  46,  20},
-                {59,  45,  21},
-                {60,  44,  22},
-                {61,  43,  23},
-                {62,  42,  24},
-                {63,  41,  25},
-                {64,  40,  26},
-                {65,  39,  27},
-                {66,  38,  28},
-                {67,  37,  29},
-                {68,  36,  30},
-                {69,  35,  31},
-                {69,  34,  32},
-                {69,  34,  33},
-                {70,  144, 145},
-                {70,  143, 146},
-                {70,  143, 147},
-                {70,  142, 148},
-                {71,  141, 149},
-                {72,  140, 150},
-                {73,  139, 151},
-                {74,  138, 152},
-                {75,  137, 153},
-                {76,  136, 154},
-                {77,  135, 155},
-                {78,  134, 156},
-                {79,  133, 157},
-                {80,  132, 158},
-                {81,  131, 159},
-                {82,  130, 160},
-                {83,  129, 161},
-                {84,  128, 162},
-                {85,  127, 163},
-                {86,  126, 164},
-                {87,  125, 165},
-                {88,  124, 166},
-                {89,  123, 167},
-                {89,  122, 168},
-                {89,  122, 169},
-                {89,  90,  91},
-};
-
-const uint16_t steps_race_beige[_N_RACE_STEPS_BEIGE][3] PROGMEM = {
-                {172, 210, 237},
-                {173, 211, 238},
-                {174, 212, 239},
-                {175, 213, 240},
-                {176, 214, 241},
-                {177, 215, 242},
-                {178, 216, 243},
-                {179, 217, 244},
-                {180, 218, 244},
-                {181, 219, 244},
-                {182, 220, 244},
-                {183, 221, 244},
-                {184, 221, 244},
-                {185, 221, 244},
-                {186, 221, 244},
-                {187, 221, 244},
-                {188, 221, 244},
-                {189, 221, 244},
-                {190, 222, 244},
-                {191, 223, 244},
-                {192, 224, 244},
-                {193, 225, 244},
-                {194, 226, 245},
-                {195, 227, 246},
-                {196, 228, 247},
-                {197, 229, 248},
-                {198, 230, 249},
-                {199, 231, 250},
-                {200, 232, 251},
-                {201, 233, 251},
-                {202, 233, 251},
-                {203, 233, 251},
-                {204, 234, 251},
-                {205, 235, 252},
-                {206, 236, 252},
-                {207, 236, 252},
-                {208, 236, 252},
-                {170, 209, 252},
-                {171, 209, 252},
-};
-
-const uint16_t steps_race_yellow[_N_RACE_STEPS_YELLOW][3] PROGMEM = {
-                {255, 308, 347},
-                {256, 309, 348},
-                {257, 310, 349},
-                {258, 311, 350},
-                {259, 312, 351},
-                {260, 313, 352},
-                {261, 314, 353},
-                {262, 315, 354},
-                {263, 316, 355},
-                {264, 317, 356},
-                {265, 318, 357},
-                {266, 319, 357},
-                {267, 320, 357},
-                {268, 321, 357},
-                {269, 322, 357},
-                {270, 323, 357},
-                {271, 324, 357},
-                {272, 325, 357},
-                {273, 325, 357},
-                {274, 325, 357},
-                {275, 325, 357},
-                {276, 325, 357},
-                {277, 325, 357},
-                {278, 325, 357},
-                {279, 325, 357},
-                {280, 325, 357},
-                {281, 325, 357},
-                {282, 325, 357},
-                {283, 326, 357},
-                {284, 327, 357},
-                {285, 328, 357},
-                {286, 329, 357},
-                {287, 330, 357},
-                {288, 331, 357},
-                {289, 332, 357},
-                {290, 333, 358},
-                {291, 334, 359},
-                {292, 335, 360},
-                {293, 336, 361},
-                {294, 337, 362},
-                {295, 338, 363},
-                {296, 339, 364},
-                {297, 340, 365},
-                {298, 341, 366},
-                {299, 342, 366},
-                {300, 342, 366},
-                {301, 343, 367},
-                {302, 344, 367},
-                {303, 344, 367},
-                {304, 344, 367},
-                {305, 345, 367},
-                {306, 346, 368},
-                {253, 307, 347},
-                {254, 307, 347},
-                {255, 308, 347},
-                            };
-
-const uint16_t steps_race_cyan[_N_RACE_STEPS][12] PROGMEM = {
-                {539, 513, 512},
-                {538, 514, 511},
-                {537, 515, 510},
-                {536, 516, 509},
-                {535, 517, 508},
-                {534, 518, 507},
-                {533, 519, 506},
-                {532, 520, 505},
-                {531, 521, 504},
-                {530, 522, 503},
-                {530, 523, 502},
-                {530, 523, 501},
-                {529, 524, 500},
-                {529, 525, 499},
-                {529, 525, 498},
-                {529, 528, 527},
-                {529, 528, 461},
-                {529, 462, 460},
-                {497, 463, 459},
-                {496, 464, 458},
-                {495, 465, 457},
-                {494, 466, 456},
-                {493, 467, 455},
-                {492, 468, 454},
-                {491, 469, 453},
-                {490, 470, 452},
-                {489, 471, 451},
-                {488, 472, 450},
-                {487, 473, 449},
-                {486, 474, 448},
-                {485, 475, 447},
-                {484, 476, 446},
-                {483, 477, 445},
-                {482, 478, 444},
-                {481, 479, 443},
-                {481, 480, 442},
-                {481, 480, 441},
-                {440, 394, 393},
-                {440, 394, 392},
-                {440, 395, 391},
-                {439, 396, 390},
-                {438, 397, 389},
-                {437, 398, 388},
-                {436, 399, 387},
-                {435, 400, 386},
-                {434, 401, 385},
-                {433, 402, 384},
-                {432, 403, 383},
-                {431, 404, 382},
-                {430, 405, 381},
-                {429, 406, 380},
-                {428, 407, 379},
-                {427, 408, 378},
-                {426, 409, 377},
-                {425, 410, 376},
-                {424, 411, 375},
-                {423, 412, 374},
-                {422, 413, 373},
-                {421, 414, 372},
-                {420, 415, 371},
-                {420, 416, 370},
-                {420, 416, 369},
-                {420, 419, 418},
-};
-
+uint8_t race_width = 10;
+uint8_t sparkle_count = 8;
+// step of the trains on each race table,
+// see tvframe.h
+uint8_t race_step[_N_RACE_TABLES] = {0, 0, 0, 0};
+// width and direction of the trains in
+// the frame buffer, a width of 0 has
+// them drawn in full on the next frame
+uint8_t race_drawn_width = 0;
+int race_drawn_direction = 0;
+int disable_auto_update = 0;
+// pattern and delay after the turn-on
+// pattern, from the saved settings
+uint8_t boot_pattern = 1;
+uint8_t boot_delay = 0;
+
+int n_wave = 0;
+int n_switch = 0;
+int n_breathe = 0;
+int n_race = 0;
+int n_sparkle = 0;
+int n_sound = 0;
+// frames left of the flash after a beat
+uint8_t sound_flash = 0;
+uint16_t n_anim = 0;
 
 // define a mapping of colors
 // to sides for the switch pattern
@@ -383,39 +169,474 @@ const uint16_t color_ranges[4][2] PROGMEM = {
 
 
 //store the current pattern
-volatile int ipat = 0; 
+int ipat = 0; 
 //store the current step
-volatile uint16_t istep = 0;
-volatile uint16_t iglobalStep = 0;
-volatile uint16_t ibigGlobalStep = 0;
+uint16_t istep = 0;
+
+// milliseconds since boot, from timer 0
+volatile uint16_t tick_ms = 0;
+// milliseconds the current pattern has run
+uint32_t pattern_ms = 0;
+// most timer 0 ticks its interrupt ran
+// late since the last stats query
+volatile uint8_t isr_late = 0;
 
 
 
 
 //a bool for ending updates
 //currently only used for the startup pattern
-volatile int stop_updates = 0;
+int stop_updates = 0;
 
 // variables for startup pattern
-volatile int idirection = 1;
-volatile int isub = 0;
+int idirection = 1;
+int isub = 0;
 
 // brightness, default to maximum
-volatile uint8_t brightness = _MAX_BRIGHTNESS;
+uint8_t brightness = _MAX_BRIGHTNESS;
+
+// output scale for each brightness,
+// _FULL_SCALE * (brightness/_MAX_BRIGHTNESS)^2.2
+// perceived brightness of each step, the
+// output stage puts it through the gamma
+// curve so the steps look evenly spaced
+const uint16_t brightness_scale[_MAX_BRIGHTNESS + 1] PROGMEM = {
+    0, 64, 128, 192, _FULL_SCALE,
+};
 
 // storage for active buttons
 volatile uint8_t active_buttons = 0;
 
+// Commands from the bluetooth module
+//
+// The USART interrupt only puts each byte
+// in rx_ring, as it must be short enough
+// to run between two LEDs of a frame.  The
+// main loop feeds the bytes to a small
+// state machine which runs each complete
+// command, so it never waits for the next
+// byte.  A command is two bytes, header and
+// argument, and the 0xa4 color command
+// is acknowledged with a 1 and followed
+// by three color bytes.  0xa8 carries
+// frame data while streaming, see below.
+// 0xad, n saves the settings as preset n
+// and 0xae, n goes back to it, see
+// tvsettings.h
+#define CMD_NEXT 0x4a
+#define CMD_COLOR 0xa4
+#define CMD_RACE_WIDTH 0xa5
+#define CMD_SPARKLE_COUNT 0xa6
+#define CMD_STREAM 0xa7
+#define CMD_FRAME 0xa8
+#define CMD_CODED 0xa9
+#define CMD_BATCH 0xaa
+#define CMD_PATTERN 0xab
+#define CMD_DELAY 0xac
+#define CMD_SAVE 0xad
+#define CMD_RECALL 0xae
+
+// states of the receive parser
+#define RX_HEADER 0
+#define RX_ARG 1
+#define RX_RGB 2
+#define RX_START_HI 3
+#define RX_START_LO 4
+#define RX_DATA 5
+#define RX_CODE 6
+#define RX_BATCH 7
+#define RX_CRC_HI 8
+#define RX_CRC_LO 9
+
+// a command that ends in a gap this long
+// is dropped and the parser waits for the
+// next header
+#define _RX_TIMEOUT_MS 100
+
+struct command {
+    uint8_t op;
+    uint8_t arg;
+    uint8_t rgb[3];
+};
+
+// bytes received and not parsed yet, at
+// 9600 baud about 30 ms worth, longer than
+// a frame keeps the main loop away
+#define _RX_RING_SIZE 32
+volatile uint8_t rx_ring[_RX_RING_SIZE];
+volatile uint8_t rx_head = 0;
+volatile uint8_t rx_tail = 0;
+
+// 0x4a commands of the buttons, by their
+// second byte
+#define _BUTTON_QUEUE_SIZE 4
+volatile uint8_t button_queue[_BUTTON_QUEUE_SIZE];
+volatile uint8_t button_head = 0;
+volatile uint8_t button_tail = 0;
+// bytes lost in the USART or for a full
+// ring and commands dropped as incomplete
+// or for a full button queue
+volatile uint8_t rx_dropped = 0;
+// bytes parsed since the last stats query
+uint16_t rx_bytes = 0;
+
+// parser state, only used by the main loop
+uint8_t rx_state = RX_HEADER;
+uint8_t rx_count = 0;
+uint16_t rx_last_ms = 0;
+struct command rx_cmd;
+
+// Streaming
+//
+// 0xa7, 1 stops the patterns and hands the
+// frame buffer to the host.  Each 0xa8,
+// count, start high, start low packet is
+// followed by count bytes which go straight
+// into led[] from byte start on, two LEDs
+// per byte as in tvframe.h.  A 0xa9, count
+// packet is followed by count bytes of
+// codes (see tvframe.h) which are decoded
+// into led[] as they arrive, the cursor
+// starting at LED 0.  0xa7, 2 sends
+// the frame and answers with a 1 once it
+// is out, and 0xa7, 0 resumes the patterns
+uint8_t streaming = 0;
+uint16_t rx_addr = 0;
+
+// Batches
+//
+// 0xaa, length is followed by length bytes
+// of commands and the CRC-CCITT of the
+// length and command bytes, high byte
+// first.  The commands are the usual two
+// bytes, or five for 0xa4 with the color
+// bytes following at once.  A batch is
+// only applied if the CRC matches and
+// every command in it is valid, and it is
+// answered with a single 1, or 0 if it
+// was rejected
+#define _BATCH_SIZE 48
+uint8_t batch_buf[_BATCH_SIZE];
+uint8_t batch_len = 0;
+uint16_t rx_crc = 0;
+uint8_t rx_batch_ok = 0;
+
 // define interrupts
 uint8_t TCCR1B_SEL = (1 << CS11 ) | (1 << CS10 );
 
+// millisecond clock for the frame scheduler
+ISR(TIMER0_COMPA_vect)
+{
+    // the count restarts at the compare
+    // match, so it is the time the
+    // interrupt was held off
+    uint8_t late = TCNT0;
+    if( late > isr_late ) {
+        isr_late = late;
+    }
+    tick_ms++;
+}
+
+// read the millisecond clock
+uint16_t clock_ms()
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t now = tick_ms;
+    SREG = sreg;
+    return now;
+}
+
+// Ticks of timer 0 since boot, 64 cycles
+// each.  The count wraps every 262 ms, so
+// only shorter sections can be timed
+uint16_t clock_ticks()
+{
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t ms = tick_ms;
+    uint8_t count = TCNT0;
+    // the count may have restarted before
+    // the interrupt could move the clock
+    if( TIFR0 & (1 << OCF0A) ) {
+        ms++;
+        count = TCNT0;
+    }
+    SREG = sreg;
+    return ms * (_TICK_OCR + 1) + count;
+}
+
 // define interrupt for receiving
 // data from bluetooth module
+// The byte is only put in the ring here so
+// the handler stays short enough to run
+// between two LEDs of a transmitted frame
 ISR(USART_RX_vect)
 {
-    uint8_t res1 = USART_Receive();
-    uint8_t res2 = USART_Receive();
+    BENCH_MARK_ON(BENCH_UART);
+    // a byte was lost in hardware if the
+    // interrupt came too late
+    if( UCSR0A & (1<<DOR0) ) {
+        rx_dropped++;
+    }
+    uint8_t data = UDR0;
+    uint8_t head = rx_head;
+    uint8_t next = (head + 1) & (_RX_RING_SIZE - 1);
+    if( next == rx_tail ) {
+        rx_dropped++;
+    }
+    else {
+        rx_ring[head] = data;
+        rx_head = next;
+    }
+    BENCH_MARK_OFF(BENCH_UART);
+}
+
+// count a byte or command lost, the
+// interrupts count theirs as well
+static void rx_drop()
+{
+    uint8_t sreg = SREG;
+    cli();
+    rx_dropped++;
+    SREG = sreg;
+}
+
+// Parse every byte in the ring, called by
+// the main loop before each frame.  A
+// command runs as soon as it is complete,
+// before the bytes after it are parsed, so
+// the frame data that follows 0xa7, 1 is
+// taken and the data after 0xa7, 0 is not
+void receive_bytes()
+{
+    while( rx_tail != rx_head ) {
+        uint8_t tail = rx_tail;
+        uint8_t data = rx_ring[tail];
+        rx_tail = (tail + 1) & (_RX_RING_SIZE - 1);
+        receive_byte(data);
+    }
+}
+
+// feed one received byte to the parser
+void receive_byte(uint8_t data)
+{
+    uint16_t now = clock_ms();
+    rx_bytes++;
+
+    // give up on a command that stalled
+    if( rx_state != RX_HEADER && (uint16_t)(now - rx_last_ms) > _RX_TIMEOUT_MS ) {
+        rx_state = RX_HEADER;
+        rx_drop();
+    }
+    rx_last_ms = now;
+
+    if( rx_state == RX_HEADER ) {
+        // anything but a known header is
+        // skipped until the stream is back
+        // in step
+        if( data == CMD_NEXT || data == CMD_COLOR ||
+            data == CMD_RACE_WIDTH || data == CMD_SPARKLE_COUNT ||
+            data == CMD_STREAM || data == CMD_FRAME ||
+            data == CMD_CODED || data == CMD_BATCH ||
+            data == CMD_PATTERN || data == CMD_DELAY ||
+            data == CMD_SAVE || data == CMD_RECALL ) {
+            rx_cmd.op = data;
+            rx_state = RX_ARG;
+        }
+    }
+    else if( rx_state == RX_ARG ) {
+        rx_cmd.arg = data;
+        if( rx_cmd.op == CMD_COLOR ) {
+            // request the color bytes
+            USART_Transmit(1);
+            rx_count = 0;
+            rx_state = RX_RGB;
+        }
+        else if( rx_cmd.op == CMD_FRAME ) {
+            rx_count = data;
+            rx_state = RX_START_HI;
+        }
+        else if( rx_cmd.op == CMD_CODED ) {
+            rx_count = data;
+            fb_decode_start();
+            rx_state = rx_count ? RX_CODE : RX_HEADER;
+        }
+        else if( rx_cmd.op == CMD_BATCH ) {
+            rx_batch_ok = data <= _BATCH_SIZE;
+            rx_count = data;
+            batch_len = 0;
+            rx_crc = _crc_ccitt_update(0xffff, data);
+            rx_state = rx_count ? RX_BATCH : RX_CRC_HI;
+        }
+        else {
+            rx_state = RX_HEADER;
+            handle_command(rx_cmd.op, rx_cmd.arg, rx_cmd.rgb);
+        }
+    }
+    else if( rx_state == RX_RGB ) {
+        rx_cmd.rgb[rx_count++] = data;
+        if( rx_count == 3 ) {
+            rx_state = RX_HEADER;
+            handle_command(rx_cmd.op, rx_cmd.arg, rx_cmd.rgb);
+        }
+    }
+    else if( rx_state == RX_START_HI ) {
+        rx_addr = data << 8;
+        rx_state = RX_START_LO;
+    }
+    else if( rx_state == RX_START_LO ) {
+        rx_addr |= data;
+        rx_state = rx_count ? RX_DATA : RX_HEADER;
+    }
+    else if( rx_state == RX_BATCH ) {
+        rx_crc = _crc_ccitt_update(rx_crc, data);
+        if( rx_batch_ok ) {
+            batch_buf[batch_len++] = data;
+        }
+        if( !--rx_count ) {
+            rx_state = RX_CRC_HI;
+        }
+    }
+    else if( rx_state == RX_CRC_HI ) {
+        if( data != (rx_crc >> 8) ) {
+            rx_batch_ok = 0;
+        }
+        rx_state = RX_CRC_LO;
+    }
+    else if( rx_state == RX_CRC_LO ) {
+        if( data != (uint8_t)rx_crc ) {
+            rx_batch_ok = 0;
+        }
+        if( !rx_batch_ok ) {
+            rx_drop();
+        }
+        rx_state = RX_HEADER;
+        handle_command(rx_cmd.op, rx_batch_ok, rx_cmd.rgb);
+    }
+    else if( rx_state == RX_CODE ) {
+        if( streaming ) {
+            fb_decode(data);
+        }
+        if( !--rx_count ) {
+            rx_state = RX_HEADER;
+        }
+    }
+    else {
+        // frame data is only taken while
+        // streaming, but always counted to
+        // stay in step.  An LED past the
+        // palette is taken as off, as the
+        // output reads its color from there
+        if( streaming && rx_addr < _FB_BYTES ) {
+            if( (data & 0x0f) >= _N_COLORS ) {
+                data &= 0xf0;
+            }
+            if( (data >> 4) >= _N_COLORS ) {
+                data &= 0x0f;
+            }
+            led[rx_addr] = data;
+        }
+        rx_addr++;
+        if( !--rx_count ) {
+            rx_state = RX_HEADER;
+        }
+    }
+}
+
+// hand a 0x4a command of a button to the
+// main loop, called from the button timer
+// interrupt only
+void queue_button(uint8_t arg)
+{
+    uint8_t next = (button_head + 1) & (_BUTTON_QUEUE_SIZE - 1);
+    if( next == button_tail ) {
+        rx_dropped++;
+        return;
+    }
+    button_queue[button_head] = arg;
+    button_head = next;
+}
+
+// run the queued commands of the buttons
+void handle_buttons()
+{
+    while( button_tail != button_head ) {
+        uint8_t tail = button_tail;
+        handle_command(CMD_NEXT, button_queue[tail], 0);
+        button_tail = (tail + 1) & (_BUTTON_QUEUE_SIZE - 1);
+    }
+}
+
+// run a complete command, from the parser
+// or the buttons.  rgb is only read for
+// the 0xa4 color command.  For a batch
+// arg tells if it arrived intact
+void handle_command(uint8_t op, uint8_t arg, uint8_t *rgb)
+{
+    if( op == CMD_BATCH ) {
+        uint8_t ok = arg && check_batch();
+        if( ok ) {
+            run_batch();
+        }
+        USART_Transmit(ok);
+    }
+    else {
+        run_command(op, arg, rgb);
+    }
+    stats.commands++;
+}
+
+// length of the batch command starting
+// with op, 0 if it is not allowed in a batch
+uint8_t batch_command_length(uint8_t op)
+{
+    if( op == 0xa4 ) {
+        return 5;
+    }
+    if( op == 0x4a || op == 0xa5 || op == 0xa6 ||
+        op == 0xab || op == 0xac || op == 0xad || op == 0xae ) {
+        return 2;
+    }
+    return 0;
+}
 
+// check that the batch holds only whole
+// commands that may be batched.  The stats
+// query is not one of them, its record
+// would go out in front of the batch answer
+uint8_t check_batch()
+{
+    uint8_t i = 0;
+    while( i < batch_len ) {
+        uint8_t len = batch_command_length(batch_buf[i]);
+        if( len == 0 || i + len > batch_len ) {
+            return 0;
+        }
+        if( batch_buf[i] == 0x4a && batch_buf[i + 1] == 0x05 ) {
+            return 0;
+        }
+        i += len;
+    }
+    return 1;
+}
+
+// run every command of a checked batch
+// before the next frame is drawn
+void run_batch()
+{
+    uint8_t i = 0;
+    while( i < batch_len ) {
+        uint8_t *c = &batch_buf[i];
+        run_command(c[0], c[1], &c[2]);
+        i += batch_command_length(c[0]);
+    }
+}
+
+// run one command, rgb holds the color of
+// a 0xa4 command
+void run_command(uint8_t res1, uint8_t res2, uint8_t *rgb)
+{
     if( res1 == 0x4a && res2 == 0x01 ) {
         // Move to the next pattern
         update_pattern();
@@ -443,20 +664,16 @@ ISR(USART_RX_vect)
         }
         
     }
+    if( res1 == 0x4a && res2 == 0x05 ) {
+        // answer with the counters
+        send_stats();
+    }
 
     if( res1 == 0xa4){
         // map one color (res2) 
         // into new RGB values
         // Each of 1 byte
-        //
-        // Transmit a byte to 
-        // request additional
-        // data
-        USART_Transmit(1);
-        uint8_t col1 = USART_Receive();
-        uint8_t col2 = USART_Receive();
-        uint8_t col3 = USART_Receive();
-        change_color(res2, col1, col2, col3);
+        change_color(res2, rgb[0], rgb[1], rgb[2]);
     }
     if( res1 == 0xa5){
         race_width = res2;
@@ -467,7 +684,126 @@ ISR(USART_RX_vect)
     if( res1 == 0xa6){
         sparkle_count = res2;
     }
-        
+    if( res1 == 0xab ){
+        // go to the given pattern
+        set_pattern(res2);
+    }
+    if( res1 == 0xac ){
+        // frames per step of the
+        // current pattern
+        set_delay(res2);
+    }
+    if( res1 == 0xad ){
+        // keep the settings as preset res2
+        settings_save_preset(res2);
+    }
+    if( res1 == 0xae ){
+        // go back to preset res2
+        struct settings s;
+        if( settings_load_preset(res2, &s) ) {
+            apply_settings(&s, 0);
+        }
+    }
+    if( res1 == 0xa7 && res2 == 0x00 ) {
+        // back to the patterns
+        streaming = 0;
+    }
+    if( res1 == 0xa7 && res2 == 0x01 ) {
+        // the host draws the frames
+        streaming = 1;
+        race_drawn_width = 0;
+        fb_fade(0);
+    }
+    if( res1 == 0xa7 && res2 == 0x02 && streaming ) {
+        // send the streamed frame and
+        // tell the host it can send
+        // the next one
+        show_leds(_MAX_BRIGHTNESS);
+        USART_Transmit(1);
+    }
+
+    // the settings are saved once they
+    // stop changing
+    if( (res1 == 0x4a && res2 != 0x05) || res1 == 0xa4 || res1 == 0xa5 || res1 == 0xa6 ||
+        res1 == 0xab || res1 == 0xac || res1 == 0xae ) {
+        settings_changed(clock_ms());
+    }
+}
+
+// send the performance counters, see
+// tvstats.h, unless the last ones are
+// still going out
+void send_stats()
+{
+    if( stats_busy() ) {
+        return;
+    }
+    uint8_t sreg = SREG;
+    cli();
+    uint16_t bytes = rx_bytes;
+    uint8_t dropped = rx_dropped;
+    uint8_t late = isr_late;
+    rx_bytes = 0;
+    rx_dropped = 0;
+    isr_late = 0;
+    SREG = sreg;
+    stats_send(clock_ms(), bytes, dropped, late);
+}
+
+// the settings as they are now, to be
+// saved by tvsettings.c
+void settings_get(struct settings *s)
+{
+    for( uint8_t ic = 0; ic < 4; ic++ ) {
+        s->colors[ic][0] = palette[ic + 1][0];
+        s->colors[ic][1] = palette[ic + 1][1];
+        s->colors[ic][2] = palette[ic + 1][2];
+    }
+    s->race_width = race_width;
+    s->sparkle_count = sparkle_count;
+    s->brightness = brightness;
+    s->pattern = ipat;
+    s->delay = DELAY;
+    s->disable_auto_update = disable_auto_update;
+}
+
+// Use saved settings.  At start up the
+// pattern and delay wait for the end of
+// the turn-on pattern, otherwise the sign
+// goes to the pattern at once
+void apply_settings(const struct settings *s, uint8_t boot)
+{
+    for( uint8_t ic = 0; ic < 4; ic++ ) {
+        palette[ic + 1][0] = s->colors[ic][0];
+        palette[ic + 1][1] = s->colors[ic][1];
+        palette[ic + 1][2] = s->colors[ic][2];
+    }
+    fb_palette_changed();
+    race_width = s->race_width;
+    if( race_width > MAX_RACE_WIDTH ) {
+        race_width = MAX_RACE_WIDTH;
+    }
+    sparkle_count = s->sparkle_count;
+    brightness = s->brightness;
+    if( brightness == 0 || brightness > _MAX_BRIGHTNESS ) {
+        brightness = _MAX_BRIGHTNESS;
+    }
+    fb_brightness(pgm_read_word(&brightness_scale[brightness]));
+    disable_auto_update = s->disable_auto_update != 0;
+
+    // a pattern that no longer exists or
+    // the turn-on pattern are left out
+    if( s->pattern == 0 || s->pattern >= _N_PAT ) {
+        return;
+    }
+    if( boot ) {
+        boot_pattern = s->pattern;
+        boot_delay = s->delay;
+    }
+    else {
+        set_pattern(s->pattern);
+        set_delay(s->delay);
+    }
 }
 
 // define the interrupts for button
@@ -479,18 +815,24 @@ ISR(USART_RX_vect)
 // within the window.  This prevents
 // multiple activations from button bounce
 // and should be smoother
+//
+// The buttons queue the same commands as
+// the next, speed and brightness requests
+// of the bluetooth module, so the pattern
+// changes between two frames in the main
+// loop rather than in the interrupt
 ISR( TIMER1_OVF_vect ) {
     
     TCCR1B &= ~TCCR1B_SEL;
 
     if( active_buttons & (1 << BUTTON_PATTERN) ){
-        update_pattern();
+        queue_button(0x01);
     }
     else if( active_buttons & ( 1 << BUTTON_SPEED ) ) {
-        update_speed();
+        queue_button(0x02);
     }
     else if( active_buttons & (1 << BUTTON_BRIGHT ) ) {
-        update_brightness();
+        queue_button(0x03);
     }
     active_buttons = 0;
 
@@ -521,22 +863,72 @@ ISR(PCINT2_vect){
 // for next pattern
 void update_pattern()
 {
-    ipat++;
+    uint8_t next = ipat + 1;
+    if( next >= _N_PAT ) { 
+        next = 1;
+    }
+    set_pattern(next);
+}
+
+// start a pattern from its first step
+// the turn-on pattern cannot be selected
+void set_pattern(uint8_t pat)
+{
+    if( pat == 0 || pat >= _N_PAT ) {
+        return;
+    }
+    ipat = pat;
     istep = 0;
-    iglobalStep = 0;
-    ibigGlobalStep = 0;
-    if( ipat >= _N_PAT ) { 
-        ipat = 1;
+    pattern_ms = 0;
+    race_drawn_width = 0;
+    DELAY = pattern_delay(_ANIM_NOM_DELAY);
+    // the ADC only runs for the sound pattern
+    if( ipat == _SOUND_PATTERN ) {
+        n_sound = 0;
+        sound_start();
+    }
+    else {
+        sound_stop();
+    }
+    if( ipat >= _N_BUILTIN ) {
+        n_anim = 0;
+        anim_start(ipat - _N_BUILTIN);
     }
-    DELAY = nom_delays[ipat];
 
-    for( int il = 0 ; il < _MAX_LED; il++ ) {
-        led[il].r=0;
-        led[il].g=0;
-        led[il].b=0;
+    // the new pattern draws from a clear
+    // frame while the old one fades out
+    fb_fade(_FADE_FRAMES);
+    fb_clear();
+}
+
+// set the frames per step of the current
+// pattern within its limits
+void set_delay(uint8_t delay)
+{
+    if( delay > pattern_delay(_ANIM_MAX_DELAY) ) {
+        delay = pattern_delay(_ANIM_MAX_DELAY);
+    }
+    if( delay < pattern_delay(_ANIM_MIN_DELAY) ) {
+        delay = pattern_delay(_ANIM_MIN_DELAY);
     }
+    DELAY = delay;
+}
 
-    ws2812_setleds(led,_MAX_LED);
+// a delay limit of the current pattern,
+// field is one of the _ANIM_*_DELAY
+// header fields
+uint8_t pattern_delay(uint8_t field)
+{
+    if( ipat >= _N_BUILTIN ) {
+        return anim_delay(ipat - _N_BUILTIN, field);
+    }
+    if( field == _ANIM_MAX_DELAY ) {
+        return max_delays[ipat];
+    }
+    if( field == _ANIM_MIN_DELAY ) {
+        return min_delays[ipat];
+    }
+    return nom_delays[ipat];
 }
 
 // update the speed of the pattern
@@ -548,7 +940,7 @@ void update_speed()
 {
     int prev_step = istep/DELAY;
     if( DELAY == 1) {
-        DELAY=max_delays[ipat];
+        DELAY=pattern_delay(_ANIM_MAX_DELAY);
     } else{
         DELAY /= 2;
     }
@@ -566,6 +958,7 @@ void update_brightness()
     {
         brightness = _MAX_BRIGHTNESS;
     }
+    fb_brightness(pgm_read_word(&brightness_scale[brightness]));
 }
 
 int main(void)
@@ -580,6 +973,22 @@ int main(void)
     PCICR |= (1 << PCIE2);
     PCMSK2 = 0;
     PCMSK2 |= (1 << PCINT20);
+    // timer 0 in CTC mode with a 1ms period
+    TCCR0A = (1 << WGM01);
+    OCR0A = _TICK_OCR;
+    TCCR0B = (1 << CS01) | (1 << CS00);
+    TIMSK0 = (1 << OCIE0A);
+    BENCH_MARK_INIT();
+#if defined(TV_BENCH_MARKERS)
+    fb_bench();
+#endif
+
+    // the saved settings hold from the
+    // first frame on
+    struct settings saved;
+    if( settings_load(&saved) ) {
+        apply_settings(&saved, 1);
+    }
 
     sei();
 
@@ -587,41 +996,94 @@ int main(void)
     USART_Init(207);
 
     _delay_ms(100);
+
+    uint16_t last_frame = clock_ms();
+    uint16_t next_frame = last_frame;
     while(1) {
-        
-        if( ipat == 0 ) { 
-           run_turnon();
-           if( ibigGlobalStep >= 10 ) {
-               update_pattern();
-           }
-        }
-        if( ipat == 1 ) { 
-            run_wave();
-        }
-        if( ipat == 2 ) { 
-            run_switch();
+        // every byte received is parsed, and
+        // every command received or queued by
+        // the buttons is applied, before the
+        // next frame is drawn
+        receive_bytes();
+        handle_buttons();
+        uint16_t now = clock_ms();
+        // at most one byte of a settings save
+        settings_poll(now);
+        // the patterns and their time stand
+        // still while the host is streaming
+        if( streaming ) {
+            last_frame = now;
+            next_frame = now;
+            continue;
         }
-        if( ipat == 3 ) { 
-            run_breathe();
+        if( (int16_t)(now - next_frame) < 0 ) {
+            continue;
         }
-        if( ipat == 4 ) { 
-            run_race(race_width, 0);
-        }
-        if( ipat == 5 ) { 
-            run_race(race_width, 1);
-        }
-        else if( ipat == 6 ) { 
-            run_sparkle();
+        pattern_ms += (uint16_t)(now - last_frame);
+        last_frame = now;
+
+        BENCH_MARK_ON(BENCH_RENDER);
+        uint16_t start = stats_frame_start();
+        run_frame();
+        stats_frame(start);
+        BENCH_MARK_OFF(BENCH_RENDER);
+
+        // a frame that runs past the next one
+        // is counted, for the stats query, and
+        // the schedule restarts from now
+        // rather than rushing frames out to
+        // catch up
+        next_frame += _FRAME_MS;
+        now = clock_ms();
+        if( (int16_t)(now - next_frame) >= 0 ) {
+            stats.late++;
+            stats.skipped += (uint16_t)(now - next_frame) / _FRAME_MS;
+            next_frame = now;
         }
+    }
 
-        istep++;
-        iglobalStep++;
-        if( iglobalStep == 0 ){
-            ibigGlobalStep++;
-        }
+}
 
+// Run one frame of the current
+// pattern and advance the step counter
+void run_frame()
+{
+    if( ipat == 0 ) { 
+       run_turnon();
+       if( pattern_ms >= _TURNON_MS ) {
+           set_pattern(boot_pattern);
+           if( boot_delay ) {
+               set_delay(boot_delay);
+           }
+       }
+    }
+    if( ipat == 1 ) { 
+        run_wave();
+    }
+    if( ipat == 2 ) { 
+        run_switch();
+    }
+    if( ipat == 3 ) { 
+        run_breathe();
+    }
+    if( ipat == 4 ) { 
+        run_race(race_width, 0);
     }
+    if( ipat == 5 ) { 
+        run_race(race_width, 1);
+    }
+    else if( ipat == 6 ) { 
+        run_sparkle();
+    }
+    else if( ipat == _SOUND_PATTERN ) {
+        run_sound();
+    }
+    else if( ipat >= _N_BUILTIN ) {
+        run_anim();
+    }
+    fb_fade_frame();
 
+    istep++;
 }
 
 
@@ -638,28 +1100,8 @@ void run_turnon(){
     if( stop_updates == 1 ) { 
         return;
     }
-    for( int il = _START_VIOLET ; il < _START_BEIGE; il++ ) {
-
-        led[il].r=violet[0]*istep;
-        led[il].g=violet[1]*istep;
-        led[il].b=violet[2]*istep;
-    }
-    for( int il = _START_BEIGE ; il < _START_YELLOW; il++ ) {
-        led[il].r=beige[0]*istep;
-        led[il].g=beige[1]*istep;
-        led[il].b=beige[2]*istep;
-    }
-    for( int il = _START_YELLOW ; il < _START_CYAN; il++ ) {
-        led[il].r=yellow[0]*istep;
-        led[il].g=yellow[1]*istep;
-        led[il].b=yellow[2]*istep;
-    }
-    for( int il = _START_CYAN ; il < _MAX_LED; il++ ) {
-        led[il].r=cyan[0]*istep;
-        led[il].g=cyan[1]*istep;
-        led[il].b=cyan[2]*istep;
-    }
-    ws2812_setleds(led,_MAX_LED);
+    fb_sides();
+    show_leds(istep);
     //_delay_ms(DELAY); 
 
 }
@@ -672,8 +1114,10 @@ void run_turnon(){
 // from outside ring
 void run_wave() {
 
-    if( istep/DELAY >= 3 ) { 
+    uint16_t ring = istep/DELAY;
+    if( ring >= _N_RINGS ) { 
         istep = 0;
+        ring = 0;
         n_wave++;
     }
     if( n_wave >= _MAX_WAVE && disable_auto_update == 0) {
@@ -681,207 +1125,9 @@ void run_wave() {
         n_wave = 0;
     }
 
-    for( int il = 0 ; il < _MAX_LED; il++ ) {
-        led[il].r=0;
-        led[il].g=0;
-        led[il].b=0;
-    }
-    if( istep/DELAY == 0 ) { 
-        for( int il = 0 ; il < 11; il++ ) {
-            led[il].r=violet[0]*brightness;
-            led[il].g=violet[1]*brightness;
-            led[il].b=violet[2]*brightness;
-        }
-        for( int il = 53 ; il < 70; il++ ) {
-            led[il].r=violet[0]*brightness;
-            led[il].g=violet[1]*brightness;
-            led[il].b=violet[2]*brightness;
-        }
-        for( int il = 74 ; il < 90; il++ ) {
-            led[il].r=violet[0]*brightness;
-            led[il].g=violet[1]*brightness;
-            led[il].b=violet[2]*brightness;
-        }
-        for( int il = 237 ; il < 253; il++ ) {
-            led[il].r=beige[0]*brightness;
-            led[il].g=beige[1]*brightness;
-            led[il].b=beige[2]*brightness;
-        }
-        for( int il = 347 ; il < 369; il++ ) {
-            led[il].r=yellow[0]*brightness;
-            led[il].g=yellow[1]*brightness;
-            led[il].b=yellow[2]*brightness;
-        }
-        for( int il = 420 ; il < 437; il++ ) {
-            led[il].r=cyan[0]*brightness;
-            led[il].g=cyan[1]*brightness;
-            led[il].b=cyan[2]*brightness;
-        }
-        for( int il = 481 ; il < 498; il++ ) {
-            led[il].r=cyan[0]*brightness;
-            led[il].g=cyan[1]*brightness;
-            led[il].b=cyan[2]*brightness;
-        }
-        for( int il = 529 ; il < _MAX_LED; il++ ) {
-            led[il].r=cyan[0]*brightness;
-            led[il].g=cyan[1]*brightness;
-            led[il].b=cyan[2]*brightness;
-        }
-
-    }
-    else if( istep/DELAY == 1) {
-        led[11].r=violet[0]*brightness;
-        led[11].g=violet[1]*brightness;
-        led[11].b=violet[2]*brightness;
-
-        led[72].r=violet[0]*brightness;
-        led[72].g=violet[1]*brightness;
-        led[72].b=violet[2]*brightness;
-
-        led[90].r=violet[0]*brightness;
-        led[90].g=violet[1]*brightness;
-        led[90].b=violet[2]*brightness;
-
-        led[437].r=cyan[0]*brightness;
-        led[437].g=cyan[1]*brightness;
-        led[437].b=cyan[2]*brightness;
-
-        led[419].r=cyan[0]*brightness;
-        led[419].g=cyan[1]*brightness;
-        led[419].b=cyan[2]*brightness;
-
-        led[528].r=cyan[0]*brightness;
-        led[528].g=cyan[1]*brightness;
-        led[528].b=cyan[2]*brightness;
-
-        for( int il = 34 ; il < 53; il++ ) {
-            led[il].r=violet[0]*brightness;
-            led[il].g=violet[1]*brightness;
-            led[il].b=violet[2]*brightness;
-        }
-        for( int il = 92 ; il < 105; il++ ) {
-            led[il].r=violet[0]*brightness;
-            led[il].g=violet[1]*brightness;
-            led[il].b=violet[2]*brightness;
-        }
-        for( int il = 122 ; il < 142; il++ ) {
-            led[il].r=violet[0]*brightness;
-            led[il].g=violet[1]*brightness;
-            led[il].b=violet[2]*brightness;
-        }
-        for( int il = 209 ; il < 237; il++ ) {
-            led[il].r=beige[0]*brightness;
-            led[il].g=beige[1]*brightness;
-            led[il].b=beige[2]*brightness;
-        }
-        for( int il = 307 ; il < 347; il++ ) {
-            led[il].r=yellow[0]*brightness;
-            led[il].g=yellow[1]*brightness;
-            led[il].b=yellow[2]*brightness;
-        }
-        for( int il = 397 ; il < 417; il++ ) {
-            led[il].r=cyan[0]*brightness;
-            led[il].g=cyan[1]*brightness;
-            led[il].b=cyan[2]*brightness;
-        }
-        for( int il = 462 ; il < 481; il++ ) {
-            led[il].r=cyan[0]*brightness;
-            led[il].g=cyan[1]*brightness;
-            led[il].b=cyan[2]*brightness;
-        }
-        for( int il = 513 ; il < 527; il++ ) {
-            led[il].r=cyan[0]*brightness;
-            led[il].g=cyan[1]*brightness;
-            led[il].b=cyan[2]*brightness;
-        }
-    }
-    else if( istep/DELAY == 2) {
-        led[12].r=violet[0]*brightness;
-        led[12].g=violet[1]*brightness;
-        led[12].b=violet[2]*brightness;
-
-        led[70].r=violet[0]*brightness;
-        led[70].g=violet[1]*brightness;
-        led[70].b=violet[2]*brightness;
-
-        led[91].r=violet[0]*brightness;
-        led[91].g=violet[1]*brightness;
-        led[91].b=violet[2]*brightness;
-
-        led[110].r=violet[0]*brightness;
-        led[110].g=violet[1]*brightness;
-        led[110].b=violet[2]*brightness;
-
-        led[418].r=cyan[0]*brightness;
-        led[418].g=cyan[1]*brightness;
-        led[418].b=cyan[2]*brightness;
-
-        led[417].r=cyan[0]*brightness;
-        led[417].g=cyan[1]*brightness;
-        led[417].b=cyan[2]*brightness;
-        
-        led[440].r=cyan[0]*brightness;
-        led[440].g=cyan[1]*brightness;
-        led[440].b=cyan[2]*brightness;
-
-        led[394].r=cyan[0]*brightness;
-        led[394].g=cyan[1]*brightness;
-        led[394].b=cyan[2]*brightness;
-
-        led[512].r=cyan[0]*brightness;
-        led[512].g=cyan[1]*brightness;
-        led[512].b=cyan[2]*brightness;
-
-        led[527].r=cyan[0]*brightness;
-        led[527].g=cyan[1]*brightness;
-        led[527].b=cyan[2]*brightness;
-
-        led[526].r=cyan[0]*brightness;
-        led[526].g=cyan[1]*brightness;
-        led[526].b=cyan[2]*brightness;
-
-        for( int il = 13 ; il < 34; il++ ) {
-            led[il].r=violet[0]*brightness;
-            led[il].g=violet[1]*brightness;
-            led[il].b=violet[2]*brightness;
-        }
-        for( int il = 105 ; il < 122; il++ ) {
-            led[il].r=violet[0]*brightness;
-            led[il].g=violet[1]*brightness;
-            led[il].b=violet[2]*brightness;
-        }
-        for( int il = 144 ; il < 170; il++ ) {
-            led[il].r=violet[0]*brightness;
-            led[il].g=violet[1]*brightness;
-            led[il].b=violet[2]*brightness;
-        }
-        for( int il = 170 ; il < 209; il++ ) {
-            led[il].r=beige[0]*brightness;
-            led[il].g=beige[1]*brightness;
-            led[il].b=beige[2]*brightness;
-        }
-        for( int il = 253 ; il < 307; il++ ) {
-            led[il].r=yellow[0]*brightness;
-            led[il].g=yellow[1]*brightness;
-            led[il].b=yellow[2]*brightness;
-        }
-        for( int il = 369 ; il < 394; il++ ) {
-            led[il].r=cyan[0]*brightness;
-            led[il].g=cyan[1]*brightness;
-            led[il].b=cyan[2]*brightness;
-        }
-        for( int il = 441 ; il < 462; il++ ) {
-            led[il].r=cyan[0]*brightness;
-            led[il].g=cyan[1]*brightness;
-            led[il].b=cyan[2]*brightness;
-        }
-        for( int il = 498 ; il < 513; il++ ) {
-            led[il].r=cyan[0]*brightness;
-            led[il].g=cyan[1]*brightness;
-            led[il].b=cyan[2]*brightness;
-        }
-    }
-    ws2812_setleds(led,_MAX_LED);
+    fb_clear();
+    fb_ring(ring);
+    show_leds(_MAX_BRIGHTNESS);
 
 }
 
@@ -895,6 +1141,7 @@ void run_switch(){
     if( patStep >= 12 ) { 
         n_switch++;
         istep = 0;
+        patStep = 0;
     }
     if(n_switch >= _MAX_SWITCH && disable_auto_update == 0){
         n_switch = 0;
@@ -915,28 +1162,12 @@ void run_switch(){
     uint16_t startc = pgm_read_word(&(color_ranges[pat3][0]));
     uint16_t endc = pgm_read_word(&(color_ranges[pat3][1]));
 
-    for( int il = startv; il < endv; il++ ) {
-        led[il].r=violet[0]*brightness;
-        led[il].g=violet[1]*brightness;
-        led[il].b=violet[2]*brightness;
-    }
-    for( int il = startb; il < endb; il++ ) {
-        led[il].r=beige[0]*brightness;
-        led[il].g=beige[1]*brightness;
-        led[il].b=beige[2]*brightness;
-    }
-    for( int il = starty; il < endy; il++ ) {
-        led[il].r=yellow[0]*brightness;
-        led[il].g=yellow[1]*brightness;
-        led[il].b=yellow[2]*brightness;
-    }
-    for( int il = startc; il < endc; il++ ) {
-        led[il].r=cyan[0]*brightness;
-        led[il].g=cyan[1]*brightness;
-        led[il].b=cyan[2]*brightness;
-    }
+    fb_fill(startv, endv, _VIOLET);
+    fb_fill(startb, endb, _BEIGE);
+    fb_fill(starty, endy, _YELLOW);
+    fb_fill(startc, endc, _CYAN);
 
-    ws2812_setleds(led,_MAX_LED);
+    show_leds(_MAX_BRIGHTNESS);
 }
 
 // Breathe pattern
@@ -946,12 +1177,14 @@ void run_switch(){
 // reverse 
 void run_breathe(){
 
-    
+    uint16_t patStep = istep/DELAY;
+
     // when at step 20
     // switch directions 
-    if( istep >= 20 ) { 
+    if( patStep >= 20 ) { 
         n_breathe++;
         istep = 0;
+        patStep = 0;
         if( idirection == 0 ) {
             idirection = 1 ;
         }
@@ -964,67 +1197,31 @@ void run_breathe(){
         update_pattern();
     }
 
+    uint8_t level;
+
     // fast steps
     if( idirection == 0 ) {
-        if( istep <= 10 ) {
-            isub = istep;
+        if( patStep <= 10 ) {
+            isub = patStep;
         }
         else {
-            isub = ( istep - 10 )/2 + 10;
-        }
-
-        for( int il = _START_VIOLET ; il < _START_BEIGE; il++ ) {
-            led[il].r=violet[0]*(14-isub);
-            led[il].g=violet[1]*(14-isub);
-            led[il].b=violet[2]*(14-isub);
-        }
-        for( int il = _START_BEIGE; il < _START_YELLOW; il++ ) {
-            led[il].r=beige[0]*(14-isub);
-            led[il].g=beige[1]*(14-isub);
-            led[il].b=beige[2]*(14-isub);
-        }
-        for( int il = _START_YELLOW; il < _START_CYAN; il++ ) {
-            led[il].r=yellow[0]*(14-isub);
-            led[il].g=yellow[1]*(14-isub);
-            led[il].b=yellow[2]*(14-isub);
-        }
-        for( int il = _START_CYAN; il < _MAX_LED; il++ ) {
-            led[il].r=cyan[0]*(14-isub);
-            led[il].g=cyan[1]*(14-isub);
-            led[il].b=cyan[2]*(14-isub);
+            isub = ( patStep - 10 )/2 + 10;
         }
+        level = 14-isub;
     } 
     //slow steps
     else {
-        if( istep >= 5 ) {
-            isub = istep;
+        if( patStep >= 5 ) {
+            isub = patStep;
         }
         else {
-            isub = ( istep )/2;
-        }
-        for( int il = _START_VIOLET ; il < _START_BEIGE; il++ ) {
-            led[il].r=violet[0]*(isub+1);
-            led[il].g=violet[1]*(isub+1);
-            led[il].b=violet[2]*(isub+1);
-        }
-        for( int il = _START_BEIGE; il < _START_YELLOW; il++ ) {
-            led[il].r=beige[0]*(isub+1);
-            led[il].g=beige[1]*(isub+1);
-            led[il].b=beige[2]*(isub+1);
-        }
-        for( int il = _START_YELLOW; il < _START_CYAN; il++ ) {
-            led[il].r=yellow[0]*(isub+1);
-            led[il].g=yellow[1]*(isub+1);
-            led[il].b=yellow[2]*(isub+1);
-        }
-        for( int il = _START_CYAN; il < _MAX_LED; il++ ) {
-            led[il].r=cyan[0]*(isub+1);
-            led[il].g=cyan[1]*(isub+1);
-            led[il].b=cyan[2]*(isub+1);
+            isub = ( patStep )/2;
         }
+        level = isub+1;
     }
-    ws2812_setleds(led,_MAX_LED);
-    _delay_ms(DELAY);
+
+    fb_sides();
+    show_leds(level);
 
 }
 // Racetrack pattern
@@ -1032,212 +1229,265 @@ void run_breathe(){
 // Illuminate a section of LEDs
 // that travels around the rings
 // synchronously
+//
+// The trains are only drawn in full when
+// the pattern starts or the width or
+// direction changed.  After that each
+// step only redraws the steps at both
+// ends of the trains, see race_move
 
 void run_race(uint8_t thickness, int direction){
 
 
-    int this_loc_violet_cyan = 0;
-    int this_loc_beige = 0;
-    int this_loc_yellow = 0;
-       
-    for( int il = 0 ; il < _MAX_LED; il++ ) {
-        led[il].r=0;
-        led[il].g=0;
-        led[il].b=0;
-    }
-
     if(n_race >= _MAX_RACE && disable_auto_update == 0 ){
         n_race = 0;
         update_pattern();
     }
 
+    uint8_t redraw = race_drawn_width != thickness || race_drawn_direction != direction;
     if(istep % DELAY == 0) {
         n_race++;
+        race_advance(direction);
+        if( !redraw ) {
+            race_move(thickness, direction);
+        }
+    }
+    if( redraw ) {
+        fb_clear();
+        race_draw(thickness, direction);
+        race_drawn_width = thickness;
+        race_drawn_direction = direction;
+    }
+
+    show_leds(_MAX_BRIGHTNESS);
+}
 
+// Incremental race
+//
+// A train covers width steps of its table
+// from the current step on, in the
+// direction it runs.  The last of them
+// only lights its middle LED, the first
+// its outer two and all others all three.
+// One step only changes the steps at both
+// ends, so race_move redraws just the LEDs
+// of those four steps.  An LED can be in
+// several neighbouring steps of the same
+// column, where the trains stand still on
+// one ring, so it stays lit while any step
+// of the train lights it.  No LED is in
+// two columns of a table
+//
+// The race tables are walked with cursors
+// (see tvframe.h) which follow the first
+// and last step of each train
+#define _RACE_MIDDLE 0x02
+#define _RACE_OUTER 0x05
+#define _RACE_ALL 0x07
+
+static struct race_cursor race_tail[_N_RACE_TABLES];
+static struct race_cursor race_head[_N_RACE_TABLES];
+static uint8_t race_cursors_ready = 0;
+
+// move the trains one step
+void race_advance(int direction)
+{
+    for( uint8_t t = 0; t < _N_RACE_TABLES; t++ ) {
+        uint8_t rows = race_rows(t);
         // forward
         if( direction == 0 ){
-            raceStepVioletCyan += 1;
-            raceStepBeige += 1;
-            raceStepYellow += 1;
-
-            if( raceStepVioletCyan >= _N_RACE_STEPS ) { 
-                raceStepVioletCyan = 0;
-            }
-            if( raceStepBeige >= _N_RACE_STEPS_BEIGE) { 
-                raceStepBeige = 0;
-            }
-            if( raceStepYellow >= _N_RACE_STEPS_YELLOW) { 
-                raceStepYellow = 0;
+            race_step[t] += 1;
+            if( race_step[t] >= rows ) { 
+                race_step[t] = 0;
             }
         }
         //reverse
         if( direction == 1) {
-            raceStepVioletCyan -= 1;
-            raceStepBeige -= 1;
-            raceStepYellow -= 1;
-
-            if( raceStepVioletCyan < 0 ) { 
-                raceStepVioletCyan = _N_RACE_STEPS - 1;
-            }
-            if( raceStepBeige < 0) { 
-                raceStepBeige = _N_RACE_STEPS_BEIGE - 1;
-            }
-            if( raceStepYellow < 0 ) { 
-                raceStepYellow = _N_RACE_STEPS_YELLOW - 1;
+            if( race_step[t] == 0 ) { 
+                race_step[t] = rows;
             }
+            race_step[t] -= 1;
         }
     }
+}
 
-    for(int ient=0;  ient < thickness; ient++){
+// step of a table at offset steps from
+// the start of its train
+static uint8_t race_offset(uint8_t t, int offset)
+{
+    int rows = race_rows(t);
+    int row = (race_step[t] + offset) % rows;
+    if( row < 0 ) {
+        row += rows;
+    }
+    return row;
+}
 
-        if( direction == 0) {
-            this_loc_violet_cyan = raceStepVioletCyan + ient;
-            if(this_loc_violet_cyan >= _N_RACE_STEPS){
-                this_loc_violet_cyan = this_loc_violet_cyan - _N_RACE_STEPS;
-            }
-            this_loc_beige = raceStepBeige + ient;
-            if(this_loc_beige >= _N_RACE_STEPS_BEIGE){
-                this_loc_beige = this_loc_beige - _N_RACE_STEPS_BEIGE;
-            }
-            this_loc_yellow = raceStepYellow + ient;
-            if(this_loc_yellow >= _N_RACE_STEPS_YELLOW){
-                this_loc_yellow = this_loc_yellow - _N_RACE_STEPS_YELLOW;
-            }
+// move a cursor one step along the train, or
+// back against it
+static void race_walk(struct race_cursor *c, int direction)
+{
+    if( direction == 0 ) {
+        race_next(c);
+    }
+    else {
+        race_prev(c);
+    }
+}
+
+// put the cursors of every table on the
+// first and last step of its train
+static void race_cursors(uint8_t thickness, int direction)
+{
+    int last = direction ? 1 - thickness : thickness - 1;
+    for( uint8_t t = 0; t < _N_RACE_TABLES; t++ ) {
+        if( !race_cursors_ready ) {
+            race_start(&race_tail[t], t);
+            race_start(&race_head[t], t);
         }
-        if( direction == 1) {
-            this_loc_violet_cyan = raceStepVioletCyan - ient;
-            if(this_loc_violet_cyan < 0){
-                this_loc_violet_cyan = this_loc_violet_cyan + _N_RACE_STEPS;
+        race_seek(&race_tail[t], race_step[t]);
+        race_seek(&race_head[t], race_offset(t, last));
+    }
+    race_cursors_ready = 1;
+}
+
+// draw the trains at their current step,
+// trains longer than a table wrap around
+// it more than once
+void race_draw(uint8_t thickness, int direction)
+{
+    race_cursors(thickness, direction);
+
+    for( uint8_t t = 0; t < _N_RACE_TABLES; t++ ) {
+        uint8_t color = race_color(t);
+        struct race_cursor c = race_tail[t];
+
+        for( uint8_t ient = 0; ient < thickness; ient++ ) {
+            if( ient == (thickness - 1)) {
+                fb_set(c.led[1], color);
             }
-            this_loc_beige = raceStepBeige - ient;
-            if(this_loc_beige < 0){
-                this_loc_beige = this_loc_beige + _N_RACE_STEPS_BEIGE;
+            else if( ient == 0 ){
+                fb_set(c.led[0], color);
+                fb_set(c.led[2], color);
             }
-            this_loc_yellow = raceStepYellow - ient;
-            if(this_loc_yellow < 0){
-                this_loc_yellow = this_loc_yellow + _N_RACE_STEPS_YELLOW;
+            else{
+                fb_set(c.led[0], color);
+                fb_set(c.led[1], color);
+                fb_set(c.led[2], color);
             }
+            race_walk(&c, direction);
         }
+    }
+}
 
-        uint16_t violet0 = pgm_read_word(&(steps_race_violet[this_loc_violet_cyan][0]));
-        uint16_t violet1 = pgm_read_word(&(steps_race_violet[this_loc_violet_cyan][1]));
-        uint16_t violet2 = pgm_read_word(&(steps_race_violet[this_loc_violet_cyan][2]));
-
-        uint16_t beige0 = pgm_read_word(&(steps_race_beige[this_loc_beige][0]));
-        uint16_t beige1 = pgm_read_word(&(steps_race_beige[this_loc_beige][1]));
-        uint16_t beige2 = pgm_read_word(&(steps_race_beige[this_loc_beige][2]));
-
-        uint16_t yellow0 = pgm_read_word(&(steps_race_yellow[this_loc_yellow][0]));
-        uint16_t yellow1 = pgm_read_word(&(steps_race_yellow[this_loc_yellow][1]));
-        uint16_t yellow2 = pgm_read_word(&(steps_race_yellow[this_loc_yellow][2]));
-
-        uint16_t cyan0 = pgm_read_word(&(steps_race_cyan[this_loc_violet_cyan][0]));
-        uint16_t cyan1 = pgm_read_word(&(steps_race_cyan[this_loc_violet_cyan][1]));
-        uint16_t cyan2 = pgm_read_word(&(steps_race_cyan[this_loc_violet_cyan][2]));
-
-        if( ient == (thickness - 1)) {
-            led[violet1].r=violet[0]*brightness;
-            led[violet1].g=violet[1]*brightness;
-            led[violet1].b=violet[2]*brightness;
-
-            led[beige1].r=beige[0]*brightness;
-            led[beige1].g=beige[1]*brightness;
-            led[beige1].b=beige[2]*brightness;
-
-            led[yellow1].r=yellow[0]*brightness;
-            led[yellow1].g=yellow[1]*brightness;
-            led[yellow1].b=yellow[2]*brightness;
-
-            led[cyan1].r=cyan[0]*brightness;
-            led[cyan1].g=cyan[1]*brightness;
-            led[cyan1].b=cyan[2]*brightness;
+// columns a step of a table lights with the
+// train at step, one bit per column.  A train
+// longer than the table covers steps twice
+static uint8_t race_cols(uint8_t row, int step, uint8_t n, uint8_t width, int direction)
+{
+    int i = direction ? step - row : row - step;
+    if( i < 0 ) {
+        i += n;
+    }
+    uint8_t cols = 0;
+    for( ; i < width; i += n ) {
+        if( i == width - 1 ) {
+            cols |= _RACE_MIDDLE;
         }
-        else if( ient == 0 ){
-            led[violet0].r=violet[0]*brightness;
-            led[violet0].g=violet[1]*brightness;
-            led[violet0].b=violet[2]*brightness;
-
-            led[violet2].r=violet[0]*brightness;
-            led[violet2].g=violet[1]*brightness;
-            led[violet2].b=violet[2]*brightness;
-
-            led[beige0].r=beige[0]*brightness;
-            led[beige0].g=beige[1]*brightness;
-            led[beige0].b=beige[2]*brightness;
-
-            led[beige2].r=beige[0]*brightness;
-            led[beige2].g=beige[1]*brightness;
-            led[beige2].b=beige[2]*brightness;
-
-            led[yellow0].r=yellow[0]*brightness;
-            led[yellow0].g=yellow[1]*brightness;
-            led[yellow0].b=yellow[2]*brightness;
-
-            led[yellow2].r=yellow[0]*brightness;
-            led[yellow2].g=yellow[1]*brightness;
-            led[yellow2].b=yellow[2]*brightness;
-
-            led[cyan0].r=cyan[0]*brightness;
-            led[cyan0].g=cyan[1]*brightness;
-            led[cyan0].b=cyan[2]*brightness;
-
-            led[cyan2].r=cyan[0]*brightness;
-            led[cyan2].g=cyan[1]*brightness;
-            led[cyan2].b=cyan[2]*brightness;
+        else if( i == 0 ) {
+            cols |= _RACE_OUTER;
         }
+        else {
+            cols |= _RACE_ALL;
+        }
+    }
+    return cols;
+}
 
-        else{
-            led[violet0].r=violet[0]*brightness;
-            led[violet0].g=violet[1]*brightness;
-            led[violet0].b=violet[2]*brightness;
-
-            led[violet1].r=violet[0]*brightness;
-            led[violet1].g=violet[1]*brightness;
-            led[violet1].b=violet[2]*brightness;
-
-            led[violet2].r=violet[0]*brightness;
-            led[violet2].g=violet[1]*brightness;
-            led[violet2].b=violet[2]*brightness;
-
-            led[beige0].r=beige[0]*brightness;
-            led[beige0].g=beige[1]*brightness;
-            led[beige0].b=beige[2]*brightness;
-
-            led[beige1].r=beige[0]*brightness;
-            led[beige1].g=beige[1]*brightness;
-            led[beige1].b=beige[2]*brightness;
-
-            led[beige2].r=beige[0]*brightness;
-            led[beige2].g=beige[1]*brightness;
-            led[beige2].b=beige[2]*brightness;
-
-            led[yellow0].r=yellow[0]*brightness;
-            led[yellow0].g=yellow[1]*brightness;
-            led[yellow0].b=yellow[2]*brightness;
-
-            led[yellow1].r=yellow[0]*brightness;
-            led[yellow1].g=yellow[1]*brightness;
-            led[yellow1].b=yellow[2]*brightness;
-
-            led[yellow2].r=yellow[0]*brightness;
-            led[yellow2].g=yellow[1]*brightness;
-            led[yellow2].b=yellow[2]*brightness;
-
-            led[cyan0].r=cyan[0]*brightness;
-            led[cyan0].g=cyan[1]*brightness;
-            led[cyan0].b=cyan[2]*brightness;
-
-            led[cyan1].r=cyan[0]*brightness;
-            led[cyan1].g=cyan[1]*brightness;
-            led[cyan1].b=cyan[2]*brightness;
+// set or clear one LED of the step at a cursor
+// after the train moved
+static void race_update_led(const struct race_cursor *at, uint8_t col, uint8_t color,
+                            int step, uint8_t width, int direction)
+{
+    uint8_t n = at->rows;
+    uint8_t bit = 1 << col;
+    const int8_t *deltas = at->deltas + col;
+
+    // look for a step of the train lighting the
+    // LED, in both directions along the steps
+    // holding it, which are those the LED does
+    // not move between
+    uint8_t lit = race_cols(at->row, step, n, width, direction) & bit;
+    uint8_t row = at->row;
+    for( uint8_t k = 1; k < n && !lit; k++ ) {
+        if( pgm_read_byte(deltas + 3 * row) ) {
+            break;
+        }
+        row = row + 1 == n ? 0 : row + 1;
+        lit = race_cols(row, step, n, width, direction) & bit;
+    }
+    row = at->row;
+    for( uint8_t k = 1; k < n && !lit; k++ ) {
+        row = row == 0 ? n - 1 : row - 1;
+        if( pgm_read_byte(deltas + 3 * row) ) {
+            break;
+        }
+        lit = race_cols(row, step, n, width, direction) & bit;
+    }
+    fb_set(at->led[col], lit ? color : _OFF);
+}
 
-            led[cyan2].r=cyan[0]*brightness;
-            led[cyan2].g=cyan[1]*brightness;
-            led[cyan2].b=cyan[2]*brightness;
+// redraw the ends of the trains after
+// race_advance, the frame buffer must
+// hold them at the previous step
+void race_move(uint8_t thickness, int direction)
+{
+    race_cursors(thickness, direction);
+
+    for( uint8_t t = 0; t < _N_RACE_TABLES; t++ ) {
+        uint8_t color = race_color(t);
+        // the step before the train, its first
+        // step and its last two steps
+        struct race_cursor ends[4];
+        ends[0] = race_tail[t];
+        race_walk(&ends[0], !direction);
+        ends[1] = race_tail[t];
+        ends[2] = race_head[t];
+        race_walk(&ends[2], !direction);
+        ends[3] = race_head[t];
+
+        for( uint8_t e = 0; e < 4; e++ ) {
+            for( uint8_t col = 0; col < 3; col++ ) {
+                race_update_led(&ends[e], col, color, race_step[t], thickness, direction);
+            }
         }
     }
+}
 
-    ws2812_setleds(led,_MAX_LED);
+// race step of an animation, width 0
+// is the race width setting
+void anim_race(uint8_t width, uint8_t direction)
+{
+    if( width == 0 ) {
+        width = race_width;
+    }
+    race_advance(direction);
+    race_draw(width, direction);
+}
+
+// Animation pattern
+//
+// run the animation program of the
+// current pattern, see tvanim.h
+void run_anim()
+{
+    if( anim_frame(DELAY) ) {
+        n_anim++;
+    }
+    if( n_anim >= anim_passes(ipat - _N_BUILTIN) && disable_auto_update == 0 ){
+        n_anim = 0;
+        update_pattern();
+    }
 }
 // sparkle pattern
 // Randomly select LEDs
@@ -1247,15 +1497,11 @@ void run_sparkle(){
 
     if((istep % DELAY) == 0){
         n_sparkle++;
-        for( int il = 0 ; il < _MAX_LED; il++ ) {
-            led[il].r=0;
-            led[il].g=0;
-            led[il].b=0;
-        }
+        fb_clear();
 
-        uint8_t new_seed = fill_random( led, brightness, (uint8_t)istep );
+        uint8_t new_seed = fill_random( (uint8_t)istep );
         for(int i = 0; i < sparkle_count; ++i) {
-           new_seed = fill_random( led, brightness, new_seed );
+           new_seed = fill_random( new_seed );
         }
 
     }
@@ -1263,7 +1509,47 @@ void run_sparkle(){
         n_sparkle = 0;
         update_pattern();
     }
-    ws2812_setleds(led,_MAX_LED);
+    show_leds(_MAX_BRIGHTNESS);
+}
+
+// sound pattern
+// Each side shows one band of the
+// microphone input, from bass on violet
+// to treble on cyan, as rings lit from
+// the center out.  A beat brightens the
+// sign for DELAY frames
+void run_sound()
+{
+    if( n_sound >= _MAX_SOUND && disable_auto_update == 0 ){
+        n_sound = 0;
+        update_pattern();
+        return;
+    }
+    n_sound++;
+
+    if( sound_window() ) {
+        fb_clear();
+        for( uint8_t ring = 0; ring < _N_RINGS; ring++ ) {
+            uint8_t sides = 0;
+            for( uint8_t band = 0; band < _SOUND_BANDS; band++ ) {
+                if( sound_level[band] > ring ) {
+                    sides |= 1 << (_VIOLET + band);
+                }
+            }
+            fb_ring_sides(ring, sides);
+        }
+        if( sound_beat ) {
+            sound_flash = DELAY;
+        }
+    }
+
+    if( sound_flash ) {
+        sound_flash--;
+        show_leds(_MAX_BRIGHTNESS);
+    }
+    else {
+        show_leds(_MAX_BRIGHTNESS / 2);
+    }
 }
 
 // Select random-looking value by 
@@ -1279,7 +1565,7 @@ uint8_t random( uint8_t seed ) {
 }
 
 // Set colors based on random values
-uint8_t fill_random(struct cRGB *led, int brightness, uint8_t seed )
+uint8_t fill_random( uint8_t seed )
 {
 
     uint8_t rand_violet = random( seed );
@@ -1312,21 +1598,10 @@ uint8_t fill_random(struct cRGB *led, int brightness, uint8_t seed )
 
     uint16_t val_cyan = rand_cyan + _START_CYAN;
 
-    led[rand_violet].r = violet[0]*brightness;
-    led[rand_violet].g = violet[1]*brightness;
-    led[rand_violet].b = violet[2]*brightness;
-
-    led[val_beige].r  = beige[0]*brightness;
-    led[val_beige].g  = beige[1]*brightness;
-    led[val_beige].b  = beige[2]*brightness;
-
-    led[val_yellow].r  = yellow[0]*brightness;
-    led[val_yellow].g  = yellow[1]*brightness;
-    led[val_yellow].b  = yellow[2]*brightness;
-
-    led[val_cyan].r  = cyan[0]*brightness;
-    led[val_cyan].g  = cyan[1]*brightness;
-    led[val_cyan].b  = cyan[2]*brightness;
+    fb_set(rand_violet, _VIOLET);
+    fb_set(val_beige, _BEIGE);
+    fb_set(val_yellow, _YELLOW);
+    fb_set(val_cyan, _CYAN);
 
     return rand_cyan;
 }
@@ -1344,17 +1619,14 @@ void USART_Init( uint16_t ubrr)
     UCSR0C = (3<<UCSZ00);
 }
 
-// Receive a byte from bluetooth
-uint8_t USART_Receive( void )
-{
-    // wait for data to be recieved
-    while ( !(UCSR0A & (1<<RXC0)) );
-    return UDR0;
-}
-
 // send a btye by bluetooth
 void USART_Transmit( unsigned char data )
 {
+    // a stats record goes out first, the
+    // byte is sent behind it
+    if( stats_queue(data) ) {
+        return;
+    }
     //Wait for empty transmit buffer
     while ( !( UCSR0A & (1<<UDRE0)) );
 
@@ -1366,23 +1638,24 @@ void USART_Transmit( unsigned char data )
 void change_color(uint8_t index, uint8_t col1, uint8_t col2, uint8_t col3){
 
     if(index == 1){
-        violet[0] = col1;
-        violet[1] = col2;
-        violet[2] = col3;
+        palette[_VIOLET][0] = col1;
+        palette[_VIOLET][1] = col2;
+        palette[_VIOLET][2] = col3;
     }
     if(index == 2){
-        cyan[0] = col1;
-        cyan[1] = col2;
-        cyan[2] = col3;
+        palette[_CYAN][0] = col1;
+        palette[_CYAN][1] = col2;
+        palette[_CYAN][2] = col3;
     }
     if(index == 3){
-        yellow[0] = col1;
-        yellow[1] = col2;
-        yellow[2] = col3;
+        palette[_YELLOW][0] = col1;
+        palette[_YELLOW][1] = col2;
+        palette[_YELLOW][2] = col3;
     }
     if(index == 4){
-        beige[0] = col1;
-        beige[1] = col2;
-        beige[2] = col3;
+        palette[_BEIGE][0] = col1;
+        palette[_BEIGE][1] = col2;
+        palette[_BEIGE][2] = col3;
     }
+    fb_palette_changed();
 }
@@ -7,7 +7,22 @@
 #define SHIFT_ENABLE PD6
 #define SHIFT_DATA PD5
 
+void run_frame(void);
+uint16_t clock_ms(void);
+void receive_bytes(void);
+void receive_byte(uint8_t data);
+void handle_command(uint8_t op, uint8_t arg, uint8_t *rgb);
+void queue_button(uint8_t arg);
+void handle_buttons(void);
+void run_command(uint8_t res1, uint8_t res2, uint8_t *rgb);
+uint8_t batch_command_length(uint8_t op);
+uint8_t check_batch(void);
+void run_batch(void);
+void send_stats(void);
 void update_pattern(void);
+void set_pattern(uint8_t pat);
+void set_delay(uint8_t delay);
+uint8_t pattern_delay(uint8_t field);
 void update_speed(void);
 void update_brightness(void);
 void run_turnon(void);
@@ -15,17 +30,21 @@ void run_wave(void);
 void run_switch(void);
 void run_breathe(void);
 void run_race(uint8_t thickenss, int direction);
+void race_advance(int direction);
+void race_draw(uint8_t thickness, int direction);
+void race_move(uint8_t thickness, int direction);
+void run_anim(void);
 void run_sparkle(void);
+void run_sound(void);
 
 // random helpers
-uint8_t fill_random( struct cRGB *led, int brightness, uint8_t seed );
+uint8_t fill_random( uint8_t seed );
 uint8_t random( uint8_t seed );
 
-// sound input functions
-//uint16_t ReadADC(uint8_t ADCchannel);
-
 void USART_Init(uint16_t ubrr);
-uint8_t USART_Receive(void);
 void USART_Transmit( unsigned char data );
 
+struct settings;
+void apply_settings(const struct settings *s, uint8_t boot);
+
 void change_color(uint8_t index, uint8_t col1, uint8_t col2, uint8_t col3);
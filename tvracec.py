@@ -0,0 +1,109 @@
+"""
+Delta code the race geometry of the TV sign
+
+Reads the race step tables of race_steps.h and writes
+race_geometry.h with each table as
+
+  the three LEDs of step 0,
+  three signed bytes per step with the change of each
+  LED to the next step
+
+The change from the last step leads back to step 0,
+so a cursor can walk the steps in both directions
+(see race_next and race_prev in tvframe.c).
+
+usage: tvracec.py [-o race_geometry.h] [race_steps.h]
+"""
+
+import re
+import sys
+
+# tables in the order of the race_tables entries,
+# with their palette entry
+TABLES = [
+    ('violet', '_VIOLET'),
+    ('beige', '_BEIGE'),
+    ('yellow', '_YELLOW'),
+    ('cyan', '_CYAN'),
+]
+
+def read_tables(text):
+    """ rows of every steps_race_* table """
+
+    tables = {}
+    for name, _ in TABLES:
+        m = re.search(r'steps_race_%s\[[^\]]*\]\[\d+\]\s+PROGMEM\s*=\s*\{(.*?)\};' % name, text, re.S)
+        if m is None:
+            raise ValueError('steps_race_%s not found' % name)
+        rows = re.findall(r'\{\s*(\d+)\s*,\s*(\d+)\s*,\s*(\d+)\s*\}', m.group(1))
+        tables[name] = [tuple(int(x) for x in row) for row in rows]
+    return tables
+
+def encode(rows):
+    """ the deltas of a table, three per step """
+
+    deltas = []
+    for i, row in enumerate(rows):
+        after = rows[(i + 1) % len(rows)]
+        for col in range(3):
+            d = after[col] - row[col]
+            if d < -128 or d > 127:
+                raise ValueError('step %d column %d changes by %d' % (i, col, d))
+            deltas.append(d)
+    return deltas
+
+def decode(first, deltas):
+    """ the rows back from the deltas, to check them """
+
+    rows = []
+    led = list(first)
+    for i in range(0, len(deltas), 3):
+        rows.append(tuple(led))
+        for col in range(3):
+            led[col] += deltas[i + col]
+    return rows
+
+def c_bytes(ctype, name, data):
+    rows = []
+    for i in range(0, len(data), 12):
+        rows.append('    ' + ' '.join('%d,' % b for b in data[i:i + 12]))
+    return 'const %s %s[%d] PROGMEM = {\n%s\n};\n' % (ctype, name, len(data), '\n'.join(rows))
+
+def geometry(tables, source):
+    out = ['// Race geometry, generated by tvracec.py from %s' % source,
+           '// do not edit, see tvframe.h for the format',
+           '']
+    entries = []
+    for name, color in TABLES:
+        rows = tables[name]
+        deltas = encode(rows)
+        if decode(rows[0], deltas) != rows:
+            raise ValueError('%s does not decode' % name)
+        out.append('// %s: %d steps, %d bytes as words, %d bytes coded' % (
+            name, len(rows), 6 * len(rows), 6 + len(deltas)))
+        out.append(c_bytes('int8_t', 'race_deltas_%s' % name, deltas))
+        entries.append('    {{%d, %d, %d}, %d, %s, race_deltas_%s},' % (
+            rows[0] + (len(rows), color, name)))
+    out.append('const struct race_table race_tables[_N_RACE_TABLES] PROGMEM = {')
+    out += entries
+    out.append('};')
+    return '\n'.join(out) + '\n'
+
+def main(argv):
+    out = None
+    if len(argv) > 1 and argv[0] == '-o':
+        out = argv[1]
+        argv = argv[2:]
+    source = argv[0] if argv else 'race_steps.h'
+
+    with open(source) as f:
+        text = geometry(read_tables(f.read()), source)
+    if out is None:
+        sys.stdout.write(text)
+    else:
+        with open(out, 'w') as f:
+            f.write(text)
+    return 0
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv[1:]))
@@ -0,0 +1,216 @@
+//
+// Settings of the TV sign in EEPROM
+//
+// The EEPROM takes about 3.4 ms to write a
+// byte and the avr-libc routines wait for
+// the one before, so every access here
+// checks eeprom_is_ready() first and
+// leaves the rest for the next call.
+// eeprom_update_byte() skips bytes which
+// already hold the value.
+//
+
+#include <avr/io.h>
+#include <avr/eeprom.h>
+#include <util/crc16.h>
+#include <string.h>
+#include "tvsettings.h"
+
+_Static_assert(sizeof(struct settings) == 18, "change _SETTINGS_VERSION with the layout");
+_Static_assert(_SETTINGS_END <= E2END + 1, "settings do not fit the EEPROM");
+
+uint16_t settings_saves = 0;
+
+// slot of the newest record in the ring,
+// _SETTINGS_SLOTS while there is none,
+// and its sequence
+static uint8_t newest = _SETTINGS_SLOTS;
+static uint8_t newest_seq = 0;
+
+// settings changed since the last save,
+// and when they last changed
+static uint8_t dirty = 0;
+static uint16_t dirty_ms = 0;
+// presets to save, one bit each
+static uint8_t presets_due = 0;
+
+// record being written, its ring slot or
+// _SETTINGS_SLOTS for a preset, its
+// address and the bytes written so far.
+// job_len is 0 while nothing is written
+static uint8_t job[_SETTINGS_RECORD];
+static uint8_t job_slot;
+static uint16_t job_addr;
+static uint8_t job_pos;
+static uint8_t job_len = 0;
+
+static uint16_t slot_addr(uint8_t slot)
+{
+    return _SETTINGS_RING + slot * _SETTINGS_RECORD;
+}
+
+static uint16_t record_crc(const uint8_t *r)
+{
+    uint16_t crc = _crc_ccitt_update(0xffff, _SETTINGS_VERSION);
+    for( uint8_t i = 0; i < _SETTINGS_RECORD - 2; i++ ) {
+        crc = _crc_ccitt_update(crc, r[i]);
+    }
+    return crc;
+}
+
+// read the record at addr, 1 if it is valid
+static uint8_t read_record(uint16_t addr, uint8_t *r)
+{
+    eeprom_read_block(r, (const void *)(uintptr_t)addr, _SETTINGS_RECORD);
+    uint16_t crc = record_crc(r);
+    return r[_SETTINGS_RECORD - 2] == (crc >> 8) &&
+           r[_SETTINGS_RECORD - 1] == (uint8_t)crc;
+}
+
+// Find the newest record of the ring and
+// read its settings, 0 if there is none.
+// Called once at start up, before anything
+// is written
+uint8_t settings_load(struct settings *s)
+{
+    uint8_t r[_SETTINGS_RECORD];
+    uint8_t first_valid = read_record(slot_addr(0), r);
+    uint8_t first_seq = r[0];
+    uint8_t valid = first_valid;
+    uint8_t seq = first_seq;
+
+    newest = _SETTINGS_SLOTS;
+    for( uint8_t slot = 0; slot < _SETTINGS_SLOTS; slot++ ) {
+        uint8_t next_valid = first_valid;
+        uint8_t next_seq = first_seq;
+        if( slot + 1 < _SETTINGS_SLOTS ) {
+            next_valid = read_record(slot_addr(slot + 1), r);
+            next_seq = r[0];
+        }
+        if( valid && !(next_valid && next_seq == (uint8_t)(seq + 1)) ) {
+            newest = slot;
+            newest_seq = seq;
+        }
+        valid = next_valid;
+        seq = next_seq;
+    }
+
+    dirty = 0;
+    presets_due = 0;
+    job_len = 0;
+    if( newest == _SETTINGS_SLOTS ) {
+        return 0;
+    }
+    read_record(slot_addr(newest), r);
+    memcpy(s, r + 1, sizeof(*s));
+    return 1;
+}
+
+// read preset n, 0 if it was never saved.
+// This waits for a byte being written, at
+// most one as settings_poll() writes them
+// one at a time
+uint8_t settings_load_preset(uint8_t n, struct settings *s)
+{
+    uint8_t r[_SETTINGS_RECORD];
+    if( n >= _SETTINGS_PRESETS ||
+        !read_record(_SETTINGS_PRESET + n * _SETTINGS_RECORD, r) ) {
+        return 0;
+    }
+    memcpy(s, r + 1, sizeof(*s));
+    return 1;
+}
+
+// the settings changed at now, they are
+// saved once they hold for a while
+void settings_changed(uint16_t now)
+{
+    dirty = 1;
+    dirty_ms = now;
+}
+
+// save the settings as preset n, they are
+// taken when its write starts
+void settings_save_preset(uint8_t n)
+{
+    if( n < _SETTINGS_PRESETS ) {
+        presets_due |= 1 << n;
+    }
+}
+
+// take the current settings as the record
+// to write to addr
+static void start_job(uint8_t slot, uint16_t addr, uint8_t seq)
+{
+    job[0] = seq;
+    settings_get((struct settings *)&job[1]);
+    uint16_t crc = record_crc(job);
+    job[_SETTINGS_RECORD - 2] = crc >> 8;
+    job[_SETTINGS_RECORD - 1] = crc;
+    job_slot = slot;
+    job_addr = addr;
+    job_pos = 0;
+    job_len = _SETTINGS_RECORD;
+}
+
+// the record being written holds the same
+// settings as the newest one of the ring
+static uint8_t job_unchanged()
+{
+    if( newest == _SETTINGS_SLOTS ) {
+        return 0;
+    }
+    uint16_t addr = slot_addr(newest);
+    for( uint8_t i = 1; i < _SETTINGS_RECORD - 2; i++ ) {
+        if( eeprom_read_byte((const uint8_t *)(uintptr_t)(addr + i)) != job[i] ) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Write the next byte of a save if the
+// EEPROM is free, called from the main
+// loop between frames.  Presets go first,
+// then the current settings once they
+// have not changed for _SETTINGS_HOLD_MS
+void settings_poll(uint16_t now)
+{
+    if( !eeprom_is_ready() ) {
+        return;
+    }
+    if( job_len ) {
+        eeprom_update_byte((uint8_t *)(uintptr_t)(job_addr + job_pos), job[job_pos]);
+        if( ++job_pos == job_len ) {
+            job_len = 0;
+            if( job_slot < _SETTINGS_SLOTS ) {
+                newest = job_slot;
+                newest_seq = job[0];
+            }
+            settings_saves++;
+        }
+        return;
+    }
+    if( presets_due ) {
+        uint8_t n = 0;
+        while( !(presets_due & (1 << n)) ) {
+            n++;
+        }
+        presets_due &= ~(1 << n);
+        start_job(_SETTINGS_SLOTS, _SETTINGS_PRESET + n * _SETTINGS_RECORD, 0);
+        return;
+    }
+    if( dirty && (uint16_t)(now - dirty_ms) >= _SETTINGS_HOLD_MS ) {
+        dirty = 0;
+        uint8_t slot = newest + 1;
+        if( slot >= _SETTINGS_SLOTS ) {
+            slot = 0;
+        }
+        start_job(slot, slot_addr(slot), newest_seq + 1);
+        // settings changed and changed back
+        // are not written again
+        if( job_unchanged() ) {
+            job_len = 0;
+        }
+    }
+}
@@ -0,0 +1,83 @@
+//
+// Settings of the TV sign in EEPROM
+//
+// The colors, race width, sparkle count,
+// brightness, pattern, delay and auto update
+// setting are kept as one record.  The
+// current settings go to a ring of record
+// slots, each save to the slot after the
+// last one, so the writes are spread over
+// the whole ring.  A few more slots hold
+// presets which are only written when one
+// is saved.
+//
+// A record is
+//
+//   sequence, settings, CRC high, CRC low
+//
+// with the CRC-CCITT of _SETTINGS_VERSION,
+// the sequence and the settings.  The
+// newest record in the ring is the valid
+// one whose next slot does not hold the
+// valid record that follows it, so a save
+// cut short by a power loss leaves the one
+// before it in place.
+//
+// Nothing is written from an interrupt or
+// while a frame is drawn.  The main loop
+// calls settings_poll() between frames,
+// which writes at most one byte and only
+// once the EEPROM is done with the last.
+// A change is saved after the settings
+// have not changed for _SETTINGS_HOLD_MS,
+// so a burst of commands is one record.
+//
+
+#ifndef TVSETTINGS_H_
+#define TVSETTINGS_H_
+
+#include <avr/io.h>
+
+// changes with the layout of struct settings
+// so records of another layout are ignored
+#define _SETTINGS_VERSION 1
+
+// slots of the ring and presets
+#define _SETTINGS_SLOTS 32
+#define _SETTINGS_PRESETS 8
+
+// time without a change before a save
+#define _SETTINGS_HOLD_MS 5000
+
+struct settings {
+    // palette entries 1 to 4, {R, G, B}
+    uint8_t colors[4][3];
+    uint8_t race_width;
+    uint8_t sparkle_count;
+    uint8_t brightness;
+    uint8_t pattern;
+    uint8_t delay;
+    uint8_t disable_auto_update;
+};
+
+#define _SETTINGS_RECORD (sizeof(struct settings) + 3)
+
+// EEPROM address of the ring and the presets
+#define _SETTINGS_RING 0
+#define _SETTINGS_PRESET (_SETTINGS_RING + _SETTINGS_SLOTS * _SETTINGS_RECORD)
+#define _SETTINGS_END (_SETTINGS_PRESET + _SETTINGS_PRESETS * _SETTINGS_RECORD)
+
+// records written since the start
+extern uint16_t settings_saves;
+
+// the current settings, provided by the
+// patterns, see tvpatterns.c
+void settings_get(struct settings *s);
+
+uint8_t settings_load(struct settings *s);
+uint8_t settings_load_preset(uint8_t n, struct settings *s);
+void settings_changed(uint16_t now);
+void settings_save_preset(uint8_t n);
+void settings_poll(uint16_t now);
+
+#endif /* TVSETTINGS_H_ */
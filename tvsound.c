@@ -0,0 +1,157 @@
+//
+// Sound input for the TV sign
+//
+// The Goertzel filters run on 16 bit state
+// with Q14 coefficients.  The samples are
+// cut to six bits around the middle of the
+// ADC range so the state of the lowest band
+// cannot overflow within a window.
+//
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include "tvsound.h"
+#include "bench_markers.h"
+
+// 2 cos(2 pi k / _SOUND_WINDOW) for the
+// bins k = 1, 3, 8 and 20, in Q14
+const int16_t sound_coeff[_SOUND_BANDS] PROGMEM = {
+    32610, 31357, 23170, -12540,
+};
+
+// a band below this power counts as silence,
+// and a beat needs four times as much
+#define _SOUND_FLOOR 1024
+// windows between two beats at least
+#define _SOUND_BEAT_HOLD 16
+
+// The ring only ever holds one window.  The
+// interrupt drops samples while it is full
+// and the main loop empties it at once, so
+// a window is the samples that followed the
+// last one.  Only the indices are shared
+static uint8_t ring[_SOUND_WINDOW];
+static volatile uint8_t ring_head = 0;
+static volatile uint8_t ring_tail = 0;
+
+uint8_t sound_level[_SOUND_BANDS];
+uint8_t sound_beat = 0;
+uint16_t sound_windows = 0;
+
+// power of each band the level is relative to,
+// the highest recent one
+static uint32_t peak[_SOUND_BANDS];
+// running average of the bass power
+static uint32_t bass_average = 0;
+static uint8_t beat_hold = 0;
+
+ISR(ADC_vect)
+{
+    uint8_t head = ring_head;
+    if( (uint8_t)(head - ring_tail) != _SOUND_WINDOW ) {
+        ring[head & (_SOUND_WINDOW - 1)] = ADCH;
+        ring_head = head + 1;
+    }
+}
+
+// sample the microphone in free running mode,
+// AVcc reference, eight bits left adjusted
+void sound_start()
+{
+    ADCSRA = 0;
+    ring_head = 0;
+    ring_tail = 0;
+    ADMUX = (1 << REFS0) | (1 << ADLAR) | _SOUND_CHANNEL;
+    DIDR0 = (1 << _SOUND_CHANNEL);
+    ADCSRB = 0;
+    ADCSRA = (1 << ADEN) | (1 << ADSC) | (1 << ADATE) | (1 << ADIE) |
+             (1 << ADPS2) | (1 << ADPS1) | (1 << ADPS0);
+}
+
+void sound_stop()
+{
+    ADCSRA = 0;
+}
+
+// power of one band over the window in the ring
+static uint32_t goertzel(int16_t coeff)
+{
+    int16_t s1 = 0;
+    int16_t s2 = 0;
+    uint8_t *p = ring;
+    uint8_t *stop = ring + _SOUND_WINDOW;
+    while( p < stop ) {
+        int16_t x = (int8_t)(*p++ - 128) >> 2;
+        int16_t s0 = x + (int16_t)(((int32_t)coeff * s1) >> 14) - s2;
+        s2 = s1;
+        s1 = s0;
+    }
+    int16_t cross = ((int32_t)coeff * s1) >> 14;
+    int32_t power = (int32_t)s1 * s1 + (int32_t)s2 * s2 - (int32_t)cross * s2;
+    return power > 0 ? power : 0;
+}
+
+// level of a band from its power, relative
+// to its peak which fades over about a second
+static uint8_t band_level(uint8_t band, uint32_t power)
+{
+    uint32_t top = peak[band] - (peak[band] >> 6);
+    if( top < _SOUND_FLOOR ) {
+        top = _SOUND_FLOOR;
+    }
+    if( power > top ) {
+        top = power;
+    }
+    peak[band] = top;
+
+    // half, an eighth and a 32nd of the
+    // peak power, 3, 9 and 15 dB down
+    if( power >= top >> 1 ) {
+        return 3;
+    }
+    if( power >= top >> 3 ) {
+        return 2;
+    }
+    if( power >= top >> 5 ) {
+        return 1;
+    }
+    return 0;
+}
+
+// Analyse the next window if the ring is
+// full.  Returns 1 if sound_level and
+// sound_beat were updated
+uint8_t sound_window()
+{
+    if( (uint8_t)(ring_head - ring_tail) != _SOUND_WINDOW ) {
+        return 0;
+    }
+    BENCH_MARK_B_ON(BENCH_SOUND);
+
+    uint32_t bass = 0;
+    for( uint8_t band = 0; band < _SOUND_BANDS; band++ ) {
+        uint32_t power = goertzel(pgm_read_word(&sound_coeff[band]));
+        sound_level[band] = band_level(band, power);
+        if( band == 0 ) {
+            bass = power;
+        }
+    }
+    ring_tail = ring_head;
+
+    // a beat is the bass half as loud again
+    // as its average of the last windows
+    sound_beat = 0;
+    if( beat_hold ) {
+        beat_hold--;
+    }
+    else if( bass > 4 * _SOUND_FLOOR && bass > bass_average + (bass_average >> 1) ) {
+        sound_beat = 1;
+        beat_hold = _SOUND_BEAT_HOLD;
+    }
+    bass_average = bass_average - (bass_average >> 3) + (bass >> 3);
+
+    sound_windows++;
+    BENCH_MARK_B_OFF(BENCH_SOUND);
+    return 1;
+}
@@ -0,0 +1,52 @@
+//
+// Sound input for the TV sign
+//
+// The ADC runs free on the microphone input
+// and its interrupt puts every sample in a
+// ring.  Once per frame sound_window() takes
+// a full ring as one window and runs a
+// Goertzel filter per band over it, so the
+// levels of a few frequencies are known
+// without a full FFT.  Each band is compared
+// with its own recent peak, which keeps the
+// sign reacting at any volume, and a jump of
+// the bass over its average is a beat.
+//
+
+#ifndef TVSOUND_H_
+#define TVSOUND_H_
+
+#include <avr/io.h>
+
+// ADC input of the microphone, PC5.  The
+// other PORTC pins are benchmark markers
+#define _SOUND_CHANNEL 5
+
+// samples per window, also the ring size.
+// The ADC clock is F_CPU/128 and a sample
+// takes 13 of its cycles, 9615 samples/s
+// at 16 MHz, so a window is 6.7 ms and the
+// bands are 150 Hz apart
+#define _SOUND_WINDOW 64
+#define _SOUND_RATE (F_CPU / 128 / 13)
+
+// bands at 150, 450, 1200 and 3000 Hz,
+// one per side
+#define _SOUND_BANDS 4
+
+// rings lit by the loudest band
+#define _SOUND_LEVELS 3
+
+// level of each band, 0 to _SOUND_LEVELS,
+// and whether the last window was a beat
+extern uint8_t sound_level[_SOUND_BANDS];
+extern uint8_t sound_beat;
+
+// windows analysed since the start
+extern uint16_t sound_windows;
+
+void sound_start(void);
+void sound_stop(void);
+uint8_t sound_window(void);
+
+#endif /* TVSOUND_H_ */
@@ -0,0 +1,135 @@
+//
+// Performance counters of the TV sign
+//
+// A frame and a transmit are timed from
+// two reads of clock_ticks(), so a section
+// is measured to within one tick.
+//
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+#include "tvstats.h"
+
+struct stats stats;
+
+// start of the time the counters cover
+static uint16_t stats_ms = 0;
+// ticks spent transmitting in this frame
+static uint16_t frame_transmit = 0;
+
+// the record being sent with the answers
+// queued behind it, its length and the
+// next byte
+static uint8_t reply[_STATS_RECORD + _STATS_QUEUE];
+static volatile uint8_t reply_len = 0;
+static volatile uint8_t reply_pos = 0;
+
+// ticks now, at the start of a frame
+uint16_t stats_frame_start()
+{
+    frame_transmit = 0;
+    return clock_ticks();
+}
+
+// a frame that started at start is done,
+// its render time leaves out its transmits
+void stats_frame(uint16_t start)
+{
+    uint16_t render = clock_ticks() - start - frame_transmit;
+    stats.frames++;
+    stats.render += render;
+    if( render > stats.render_max ) {
+        stats.render_max = render;
+    }
+}
+
+// a transmit that started at start is done
+void stats_transmit(uint16_t start)
+{
+    uint16_t ticks = clock_ticks() - start;
+    frame_transmit += ticks;
+    stats.sent++;
+    stats.transmit += ticks;
+    if( ticks > stats.transmit_max ) {
+        stats.transmit_max = ticks;
+    }
+}
+
+// a record is still being sent
+uint8_t stats_busy()
+{
+    return (UCSR0B & (1 << UDRIE0)) != 0;
+}
+
+static uint8_t *put_word(uint8_t *r, uint16_t w)
+{
+    r[0] = w >> 8;
+    r[1] = w;
+    return r + 2;
+}
+
+// Send the counters as a record and start
+// them over.  The counters of the
+// interrupts are taken and cleared by the
+// caller
+void stats_send(uint16_t now, uint16_t rx_bytes, uint8_t rx_dropped, uint8_t latency)
+{
+    uint8_t *r = reply;
+    *r++ = _STATS_RECORD - 1;
+    *r++ = _STATS_VERSION;
+    r = put_word(r, now - stats_ms);
+    r = put_word(r, stats.frames);
+    r = put_word(r, stats.sent);
+    r = put_word(r, stats.frames ? stats.render / stats.frames : 0);
+    r = put_word(r, stats.render_max);
+    r = put_word(r, stats.sent ? stats.transmit / stats.sent : 0);
+    r = put_word(r, stats.transmit_max);
+    r = put_word(r, stats.late);
+    r = put_word(r, stats.skipped);
+    r = put_word(r, rx_bytes);
+    *r++ = rx_dropped;
+    r = put_word(r, stats.commands);
+    *r++ = latency;
+
+    memset(&stats, 0, sizeof(stats));
+    stats_ms = now;
+
+    reply_len = _STATS_RECORD;
+    reply_pos = 0;
+    UCSR0B |= (1 << UDRIE0);
+}
+
+// Queue an answer behind the record being
+// sent, 0 if no record is going out and
+// the caller sends it itself.  Only waits
+// when _STATS_QUEUE answers are queued
+uint8_t stats_queue(uint8_t data)
+{
+    for( ;; ) {
+        uint8_t sreg = SREG;
+        cli();
+        if( !(UCSR0B & (1 << UDRIE0)) ) {
+            SREG = sreg;
+            return 0;
+        }
+        if( reply_len < sizeof(reply) ) {
+            reply[reply_len++] = data;
+            SREG = sreg;
+            return 1;
+        }
+        SREG = sreg;
+    }
+}
+
+// the next byte of the record or of the
+// answers behind it
+ISR(USART_UDRE_vect)
+{
+    uint8_t pos = reply_pos;
+    UDR0 = reply[pos++];
+    reply_pos = pos;
+    if( pos == reply_len ) {
+        UCSR0B &= ~(1 << UDRIE0);
+    }
+}
@@ -0,0 +1,78 @@
+//
+// Performance counters of the TV sign
+//
+// Time is counted in ticks of timer 0, 64
+// CPU cycles or 4 us at 16 MHz, see
+// clock_ticks() in tvpatterns.c.  The
+// counters cover the time since the last
+// 0x4a, 0x05 query, which answers with the
+// record below and starts them over.
+//
+// The record is _STATS_RECORD bytes, words
+// high byte first:
+//
+//   length      bytes that follow, 25
+//   version     _STATS_VERSION
+//   ms          (2) time the counters cover
+//   frames      (2) frames run
+//   sent        (2) frames transmitted
+//   render      (2) mean ticks of a frame
+//                   without its transmit
+//   render max  (2)
+//   transmit    (2) mean ticks of a transmit
+//   transmit max(2)
+//   late        (2) frames past their slot
+//   skipped     (2) frame slots lost to them
+//   rx bytes    (2) bytes received
+//   rx dropped      bytes and commands lost
+//   commands    (2) commands handled
+//   latency         most ticks the timer 0
+//                   interrupt ran late, the
+//                   longest time interrupts
+//                   were held off
+//
+// The record goes out from the USART data
+// register empty interrupt so the main loop
+// does not wait for the line.  Answers sent
+// meanwhile are queued behind it.
+//
+
+#ifndef TVSTATS_H_
+#define TVSTATS_H_
+
+#include <avr/io.h>
+
+#define _STATS_VERSION 1
+#define _STATS_RECORD 26
+
+// CPU cycles per tick
+#define _STATS_TICK_CYCLES 64
+
+// answers that can wait behind a record
+#define _STATS_QUEUE 8
+
+// counters of the main loop
+struct stats {
+    uint16_t frames;
+    uint16_t sent;
+    uint32_t render;
+    uint16_t render_max;
+    uint32_t transmit;
+    uint16_t transmit_max;
+    uint16_t late;
+    uint16_t skipped;
+    uint16_t commands;
+};
+extern struct stats stats;
+
+// timer 0 ticks, provided by tvpatterns.c
+uint16_t clock_ticks(void);
+
+uint16_t stats_frame_start(void);
+void stats_frame(uint16_t start);
+void stats_transmit(uint16_t start);
+uint8_t stats_busy(void);
+uint8_t stats_queue(uint8_t data);
+void stats_send(uint16_t now, uint16_t rx_bytes, uint8_t rx_dropped, uint8_t latency);
+
+#endif /* TVSTATS_H_ */
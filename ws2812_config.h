@@ -31,4 +31,51 @@
 #define ws2812_port B     // Data port 
 #define ws2812_pin  2     // Data out pin
 
+///////////////////////////////////////////////////////////////////////
+// SPI output
+//
+// Define ws2812_spi to send the data with the SPI peripheral on MOSI
+// (PB3) instead of bit-banging ws2812_pin. Each data bit becomes an
+// SPI byte at F_CPU/2, so F_CPU must be 16 MHz. Interrupts
+// are only taken in the windows below, as with the bit-banged output.
+// SCK (PB5) toggles and SS (PB2) is driven as an output while sending.
+///////////////////////////////////////////////////////////////////////
+
+//#define ws2812_spi
+
+///////////////////////////////////////////////////////////////////////
+// Interrupt windows
+//
+// The data line is clocked out with interrupts disabled. When
+// ws2812_irq_window is defined, interrupts are allowed for a moment
+// after every ws2812_irq_window bytes, so a received USART byte waits
+// at most that many bytes (10 µs each) instead of a whole frame.
+//
+// A handler that runs in a window stretches the low time of the data
+// line. It must return within about 5 µs (80 cycles at 16 MHz),
+// otherwise the LEDs latch early and the rest of the frame is lost.
+// Only one handler runs per window, others wait for the next one.
+// The USART receive handler only stores the byte for the main loop.
+// sim/simuart.c checks every handler and the low time of the line.
+///////////////////////////////////////////////////////////////////////
+
+#define ws2812_irq_window 3   // bytes between windows, one LED
+
+///////////////////////////////////////////////////////////////////////
+// Parallel output
+//
+// Define ws2812_parallel to drive four LED chains at once, one per
+// lane pin of ws2812_port, with ws2812_setleds_parallel(). The frame
+// then takes as long to send as the longest chain.
+//
+// The parallel loop is only timed for F_CPU = 16 MHz.
+///////////////////////////////////////////////////////////////////////
+
+//#define ws2812_parallel
+
+#define ws2812_lane0_pin 1   // violet side
+#define ws2812_lane1_pin 2   // beige side
+#define ws2812_lane2_pin 3   // yellow side
+#define ws2812_lane3_pin 4   // cyan side
+
 #endif /* WS2812_CONFIG_H_ */